@@ -0,0 +1,171 @@
+#include "rgbd_sensor/compression_policy.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+namespace rs2_lcm {
+namespace {
+
+std::vector<std::string> Split(const std::string& value, char separator) {
+  std::vector<std::string> parts;
+  std::stringstream stream(value);
+  std::string part;
+  while (std::getline(stream, part, separator)) parts.push_back(part);
+  return parts;
+}
+
+// Parses all of @p value as an int, naming @p entry on errors.
+int ParseInt(const std::string& value, const std::string& entry) {
+  size_t end = 0;
+  int result = 0;
+  try {
+    result = std::stoi(value, &end);
+  } catch (const std::logic_error&) {
+    end = 0;
+  }
+  if (end == 0 || end != value.size()) {
+    throw std::runtime_error("Malformed compression option value \"" + value +
+                             "\" in " + entry);
+  }
+  return result;
+}
+
+void CheckCodec(const CodecSettings& settings) {
+  // Throws for unknown codecs.
+  GetImageCodec(settings.codec);
+}
+
+// Overrides @p settings with the entries of @p tree.
+void ApplyJson(const boost::property_tree::ptree& tree,
+               CodecSettings* settings) {
+  settings->codec = tree.get<std::string>("codec", settings->codec);
+  settings->level = tree.get<int>("level", settings->level);
+  settings->quality = tree.get<int>("quality", settings->quality);
+  settings->threads = tree.get<int>("threads", settings->threads);
+  settings->shuffle = tree.get<int>("shuffle", settings->shuffle);
+  settings->subsampling =
+      tree.get<int>("subsampling", settings->subsampling);
+}
+
+}  // namespace
+
+ImageType StringToImageType(const std::string& name) {
+  for (int i = 0; i < kNumImageTypes; i++) {
+    if (ImageTypeToString(static_cast<ImageType>(i)) == name) {
+      return static_cast<ImageType>(i);
+    }
+  }
+  throw std::runtime_error("Unknown image type: " + name);
+}
+
+CompressionPolicy::CompressionPolicy() {
+  for (int i = 0; i < kNumImageTypes; i++) {
+    const ImageType type = static_cast<ImageType>(i);
+    if (is_color_image(type)) {
+      defaults_[i].codec = "jpeg";
+    } else if (is_depth_image(type)) {
+      defaults_[i].codec = "zlib";
+    } else {
+      defaults_[i].codec = "png";
+    }
+  }
+}
+
+void CompressionPolicy::Set(ImageType type, const CodecSettings& settings) {
+  CheckCodec(settings);
+  defaults_.at(static_cast<int>(type)) = settings;
+}
+
+void CompressionPolicy::Set(const std::string& camera_id, ImageType type,
+                            const CodecSettings& settings) {
+  CheckCodec(settings);
+  cameras_[std::make_pair(camera_id, type)] = settings;
+}
+
+const CodecSettings& CompressionPolicy::Get(const std::string& camera_id,
+                                            ImageType type) const {
+  auto camera = cameras_.find(std::make_pair(camera_id, type));
+  if (camera != cameras_.end()) return camera->second;
+  return defaults_.at(static_cast<int>(type));
+}
+
+void CompressionPolicy::ParseSpec(const std::string& spec) {
+  for (const std::string& entry : Split(spec, ',')) {
+    if (entry.empty()) continue;
+    const size_t equals = entry.find('=');
+    if (equals == std::string::npos) {
+      throw std::runtime_error("Malformed compression setting: " + entry);
+    }
+    std::string camera_id;
+    std::string stream = entry.substr(0, equals);
+    const size_t slash = stream.find('/');
+    if (slash != std::string::npos) {
+      camera_id = stream.substr(0, slash);
+      stream = stream.substr(slash + 1);
+    }
+    const ImageType type = StringToImageType(stream);
+
+    const std::vector<std::string> options =
+        Split(entry.substr(equals + 1), ':');
+    CodecSettings settings;
+    settings.codec = options.empty() ? "" : options[0];
+    for (size_t i = 1; i < options.size(); i++) {
+      const size_t option_equals = options[i].find('=');
+      const std::string key = options[i].substr(0, option_equals);
+      if (option_equals == std::string::npos) {
+        throw std::runtime_error("Malformed compression option: " + entry);
+      }
+      const int value = ParseInt(options[i].substr(option_equals + 1), entry);
+      if (key == "level") {
+        settings.level = value;
+      } else if (key == "quality") {
+        settings.quality = value;
+      } else if (key == "threads") {
+        settings.threads = value;
+      } else if (key == "shuffle") {
+        settings.shuffle = value;
+      } else if (key == "subsampling") {
+        settings.subsampling = value;
+      } else {
+        throw std::runtime_error("Unknown compression option: " + key);
+      }
+    }
+
+    if (camera_id.empty()) {
+      Set(type, settings);
+    } else {
+      Set(camera_id, type, settings);
+    }
+  }
+}
+
+void CompressionPolicy::LoadJson(const std::string& path) {
+  boost::property_tree::ptree tree;
+  try {
+    boost::property_tree::read_json(path, tree);
+  } catch (const boost::property_tree::json_parser_error& e) {
+    throw std::runtime_error("Failed to parse " + path + ": " + e.what());
+  }
+
+  // Defaults first, so that the cameras start from them.
+  for (const auto& stream : tree.get_child("default", {})) {
+    const ImageType type = StringToImageType(stream.first);
+    CodecSettings settings = defaults_.at(static_cast<int>(type));
+    ApplyJson(stream.second, &settings);
+    Set(type, settings);
+  }
+  for (const auto& camera : tree.get_child("cameras", {})) {
+    for (const auto& stream : camera.second) {
+      const ImageType type = StringToImageType(stream.first);
+      CodecSettings settings = Get(camera.first, type);
+      ApplyJson(stream.second, &settings);
+      Set(camera.first, type, settings);
+    }
+  }
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "rgbd_sensor/image.h"
+#include "rgbd_sensor/image_codec.h"
+
+namespace rs2_lcm {
+
+/**
+ * The CodecSettings of every image stream of every camera. Streams are named
+ * by ImageTypeToString(), cameras by RGBDSensor::camera_id().
+ */
+class CompressionPolicy {
+ public:
+  /**
+   * Starts with "jpeg" for color, "zlib" for depth and "png" for IR streams
+   * of all cameras.
+   */
+  CompressionPolicy();
+
+  /**
+   * Sets the settings of @p type for all cameras, except where a camera
+   * specific setting exists.
+   * @throws std::runtime_error if the codec is not registered.
+   */
+  void Set(ImageType type, const CodecSettings& settings);
+
+  /**
+   * Sets the settings of @p type for camera @p camera_id only.
+   * @throws std::runtime_error if the codec is not registered.
+   */
+  void Set(const std::string& camera_id, ImageType type,
+           const CodecSettings& settings);
+
+  const CodecSettings& Get(const std::string& camera_id,
+                           ImageType type) const;
+
+  /**
+   * Applies @p spec, a comma separated list of
+   * "[camera_id/]STREAM=codec[:OPTION=N]..." entries, where the options are
+   * the fields of CodecSettings (level, quality, threads, shuffle and
+   * subsampling), e.g.
+   * "DEPTH=zstd:level=1,INFRARED=lz4,1234/RGB=jpeg:quality=80".
+   * @throws std::runtime_error if @p spec is malformed.
+   */
+  void ParseSpec(const std::string& spec);
+
+  /**
+   * Applies the JSON file at @p path, which looks like
+   *
+   *     {
+   *       "default": {"DEPTH": {"codec": "rvl"}},
+   *       "cameras": {
+   *         "1234": {"RGB": {"codec": "jpeg", "quality": 80}}
+   *       }
+   *     }
+   *
+   * Both sections are optional. Settings left out of a stream keep their
+   * default.
+   * @throws std::runtime_error if the file can not be parsed.
+   */
+  void LoadJson(const std::string& path);
+
+ private:
+  std::array<CodecSettings, kNumImageTypes> defaults_;
+  // Camera specific settings, by camera id and stream.
+  std::map<std::pair<std::string, ImageType>, CodecSettings> cameras_;
+};
+
+/**
+ * Returns the ImageType named @p name by ImageTypeToString().
+ * @throws std::runtime_error if there is none.
+ */
+ImageType StringToImageType(const std::string& name);
+
+}  // namespace rs2_lcm
@@ -0,0 +1,119 @@
+#include "rgbd_sensor/depth_decimation.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace rs2_lcm {
+namespace {
+
+// Number of decimated rows per task.
+constexpr int kGrainRows = 8;
+
+// Reduces the valid depths of a block, @p values, to one.
+uint16_t ReduceBlock(DecimationMethod method, std::vector<uint16_t>* values) {
+  if (values->empty()) return 0;
+  if (method == DecimationMethod::MIN) {
+    return *std::min_element(values->begin(), values->end());
+  }
+  auto median = values->begin() + values->size() / 2;
+  std::nth_element(values->begin(), median, values->end());
+  return *median;
+}
+
+}  // namespace
+
+DecimationMethod StringToDecimationMethod(const std::string& method) {
+  if (method == "stride") return DecimationMethod::STRIDE;
+  if (method == "median") return DecimationMethod::MEDIAN;
+  if (method == "min") return DecimationMethod::MIN;
+  throw std::runtime_error("Unknown decimation method: " + method);
+}
+
+std::string to_string(DecimationMethod method) {
+  switch (method) {
+    case DecimationMethod::STRIDE:
+      return "stride";
+    case DecimationMethod::MEDIAN:
+      return "median";
+    case DecimationMethod::MIN:
+      return "min";
+  }
+  throw std::runtime_error("Invalid DecimationMethod");
+}
+
+RawImageData DecimateDepth(const RawImageData& depth, int factor,
+                           DecimationMethod method) {
+  if (factor < 1) {
+    throw std::runtime_error("Decimation factor must be positive");
+  }
+  RawImageData decimated = RawImageData::MakeUninitialized(
+      depth.rows() / factor, depth.cols() / factor, 1, sizeof(uint16_t));
+  DecimateDepth(depth, factor, method, &decimated);
+  return decimated;
+}
+
+void DecimateDepth(const RawImageData& depth, int factor,
+                   DecimationMethod method, RawImageData* decimated) {
+  if (factor < 1) {
+    throw std::runtime_error("Decimation factor must be positive");
+  }
+  if (depth.channels() != 1 || depth.scalar_size() != 2 ||
+      decimated->channels() != 1 || decimated->scalar_size() != 2) {
+    throw std::runtime_error("Depth image format is incorrect");
+  }
+  if (decimated->rows() != depth.rows() / factor ||
+      decimated->cols() != depth.cols() / factor) {
+    throw std::runtime_error("Decimated image dimension mismatch");
+  }
+
+  const int cols = decimated->cols();
+  const int src_cols = depth.cols();
+  const uint16_t* src = reinterpret_cast<const uint16_t*>(depth.data());
+  uint16_t* dst = reinterpret_cast<uint16_t*>(decimated->data());
+  tbb::parallel_for(
+      tbb::blocked_range<int>(0, decimated->rows(), kGrainRows),
+      [&](const tbb::blocked_range<int>& rows) {
+        std::vector<uint16_t> values;
+        values.reserve(factor * factor);
+        for (int v = rows.begin(); v < rows.end(); v++) {
+          const uint16_t* block_row = src + v * factor * src_cols;
+          uint16_t* out = dst + v * cols;
+          if (method == DecimationMethod::STRIDE) {
+            for (int u = 0; u < cols; u++) out[u] = block_row[u * factor];
+            continue;
+          }
+          for (int u = 0; u < cols; u++) {
+            values.clear();
+            for (int y = 0; y < factor; y++) {
+              const uint16_t* block = block_row + y * src_cols + u * factor;
+              for (int x = 0; x < factor; x++) {
+                if (block[x] != 0) values.push_back(block[x]);
+              }
+            }
+            out[u] = ReduceBlock(method, &values);
+          }
+        }
+      });
+}
+
+Intrinsics DecimateIntrinsics(const Intrinsics& intrinsics, int factor,
+                              DecimationMethod method) {
+  if (factor < 1) {
+    throw std::runtime_error("Decimation factor must be positive");
+  }
+  // Decimated pixel u samples original pixel factor * u + offset.
+  const float offset =
+      method == DecimationMethod::STRIDE ? 0.f : (factor - 1) / 2.f;
+  return Intrinsics(intrinsics.width() / factor, intrinsics.height() / factor,
+                    intrinsics.fx() / factor, intrinsics.fy() / factor,
+                    (intrinsics.ppx() - offset) / factor,
+                    (intrinsics.ppy() - offset) / factor,
+                    intrinsics.distortion_model(),
+                    intrinsics.distortion_coeffs());
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+#include "rgbd_sensor/image.h"
+#include "rgbd_sensor/intrinsics.h"
+
+namespace rs2_lcm {
+
+/// How DecimateDepth() reduces each block of pixels to one.
+enum class DecimationMethod {
+  /// Keeps the top left pixel of each block.
+  STRIDE = 0,
+  /// The median of the valid (non zero) depths of each block.
+  MEDIAN,
+  /// The closest valid depth of each block, which never invents free space.
+  MIN,
+};
+
+/**
+ * Parses "stride", "median" or "min".
+ * @throws std::runtime_error for anything else.
+ */
+DecimationMethod StringToDecimationMethod(const std::string& method);
+
+std::string to_string(DecimationMethod method);
+
+/**
+ * Returns @p depth (uint16 in mm, 0 meaning no data) reduced by @p factor in
+ * both dimensions with @p method. Trailing rows and columns that do not fill
+ * a whole block are dropped. Rows are processed in parallel.
+ * @throws std::runtime_error if @p factor < 1 or @p depth is not uint16.
+ */
+RawImageData DecimateDepth(const RawImageData& depth, int factor,
+                           DecimationMethod method);
+
+/**
+ * Same as above, writing into @p decimated, which must already have the
+ * decimated dimensions.
+ */
+void DecimateDepth(const RawImageData& depth, int factor,
+                   DecimationMethod method, RawImageData* decimated);
+
+/**
+ * Returns the intrinsics of images decimated from images with @p intrinsics
+ * by DecimateDepth() with @p factor and @p method. The block methods sample
+ * the center of each block, STRIDE its top left pixel.
+ */
+Intrinsics DecimateIntrinsics(const Intrinsics& intrinsics, int factor,
+                              DecimationMethod method);
+
+}  // namespace rs2_lcm
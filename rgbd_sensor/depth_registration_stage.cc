@@ -0,0 +1,79 @@
+#include "rgbd_sensor/depth_registration_stage.h"
+
+#include <stdexcept>
+
+#include <drake/common/text_logging.h>
+
+namespace rs2_lcm {
+namespace {
+
+// How long the worker waits for new depth before rechecking run_.
+constexpr std::chrono::milliseconds kPollPeriod(100);
+
+}  // namespace
+
+DepthRegistrationStage::DepthRegistrationStage(
+    const RGBDSensor* sensor, const std::vector<ImageType>& outputs)
+    : sensor_(sensor) {
+  for (ImageType type : outputs) {
+    if (type == ImageType::RECT_RGB_ALIGNED_DEPTH) {
+      align_depth_ = true;
+    } else if (type == ImageType::DEPTH_ALIGNED_RGB) {
+      align_color_ = true;
+    } else {
+      throw std::runtime_error("Unsupported registration output");
+    }
+  }
+  if (!align_depth_ && !align_color_) {
+    throw std::runtime_error("No registration output requested");
+  }
+
+  // Read the sequence here rather than on the worker, so that no depth image
+  // that arrives after construction is missed.
+  thread_ = std::thread(&DepthRegistrationStage::Run, this,
+                        sensor_->get_image_sequence(ImageType::DEPTH));
+}
+
+DepthRegistrationStage::~DepthRegistrationStage() {
+  run_ = false;
+  thread_.join();
+}
+
+std::shared_ptr<const DepthRegistrationStage::Result>
+DepthRegistrationStage::GetResult(const ImageFrameset& frameset) const {
+  auto result = std::make_shared<Result>();
+  if (!frameset.image(ImageType::DEPTH, &result->depth_timestamp) ||
+      !frameset.image(ImageType::RGB, &result->color_timestamp)) {
+    return nullptr;
+  }
+
+  if (align_depth_) {
+    result->aligned_depth = sensor_->GetDerivedImage(
+        ImageType::RECT_RGB_ALIGNED_DEPTH, frameset);
+  }
+  if (align_color_) {
+    result->color_uv_map = sensor_->GetColorUvMap(frameset);
+    result->aligned_color =
+        sensor_->GetDerivedImage(ImageType::DEPTH_ALIGNED_RGB, frameset);
+  }
+  return result;
+}
+
+void DepthRegistrationStage::Run(uint64_t last_seen) {
+  while (run_) {
+    const uint64_t sequence =
+        sensor_->WaitForNewFrame(ImageType::DEPTH, last_seen, kPollPeriod);
+    if (sequence == last_seen) continue;
+    last_seen = sequence;
+
+    // The result is memoized by the sensor, GetResult() callers pick it up
+    // from there.
+    try {
+      GetResult(*sensor_->GetLatestFrameset());
+    } catch (const std::exception& e) {
+      drake::log()->warn("Depth registration failed: {}", e.what());
+    }
+  }
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "rgbd_sensor/rgbd_sensor.h"
+
+namespace rs2_lcm {
+
+/**
+ * Registers depth and color images to each other (see
+ * RGBDSensor::GetDerivedImage()) on a dedicated thread. Registration starts
+ * as soon as a frameset with new depth and a color image lands in the sensor,
+ * so it runs concurrently with whatever else consumes that frameset (e.g.
+ * encoding the other images), which then only has to pick up the result.
+ */
+class DepthRegistrationStage {
+ public:
+  /// Images registered from one pair of depth and color images.
+  struct Result {
+    uint64_t depth_timestamp{0};
+    uint64_t color_timestamp{0};
+    /// ImageType::RECT_RGB_ALIGNED_DEPTH, if requested.
+    std::shared_ptr<const RawImageData> aligned_depth;
+    /// ImageType::DEPTH_ALIGNED_RGB, if requested.
+    std::shared_ptr<const RawImageData> aligned_color;
+    /// The color pixel of each depth pixel (see DoComputeColorUvMap()), set
+    /// along with aligned_color.
+    std::shared_ptr<const RawImageData> color_uv_map;
+  };
+
+  /**
+   * Starts the worker thread. @p sensor is aliased and must outlive this
+   * object.
+   * @param outputs The registered images to produce, any of
+   * ImageType::RECT_RGB_ALIGNED_DEPTH and ImageType::DEPTH_ALIGNED_RGB.
+   * @throws std::runtime_error if @p outputs is empty or has other types.
+   */
+  DepthRegistrationStage(const RGBDSensor* sensor,
+                         const std::vector<ImageType>& outputs);
+
+  /**
+   * Stops the worker thread.
+   */
+  ~DepthRegistrationStage();
+
+  DepthRegistrationStage(const DepthRegistrationStage&) = delete;
+  DepthRegistrationStage& operator=(const DepthRegistrationStage&) = delete;
+
+  /**
+   * Returns the images registered from the depth and color images of
+   * @p frameset. Since the sensor memoizes them, this waits for the worker if
+   * it is still registering @p frameset, and only registers on the calling
+   * thread if the worker skipped @p frameset for a newer one. Returns nullptr
+   * if @p frameset lacks depth or color.
+   */
+  std::shared_ptr<const Result> GetResult(const ImageFrameset& frameset) const;
+
+ private:
+  // Registers every new frameset until run_ is cleared, starting with the
+  // first depth image past @p last_seen.
+  void Run(uint64_t last_seen);
+
+  const RGBDSensor* sensor_{nullptr};
+  bool align_depth_{false};
+  bool align_color_{false};
+
+  std::atomic<bool> run_{true};
+  std::thread thread_;
+};
+
+}  // namespace rs2_lcm
@@ -71,6 +71,15 @@ bool is_infrared_image(const ImageType type) {
   }
 }
 
+RawImageData RawImageData::MakeUninitialized(int rows, int cols,
+                                             int channels, int element_size) {
+  std::shared_ptr<uint8_t> buffer(
+      new uint8_t[static_cast<size_t>(rows) * cols * element_size],
+      std::default_delete<uint8_t[]>());
+  return RawImageData(rows, cols, channels, element_size, buffer,
+                      buffer.get());
+}
+
 RawImageData::RawImageData(int rows, int cols, int channels, int element_size,
                            const void* data)
     : rows_(rows),
@@ -78,10 +87,33 @@ RawImageData::RawImageData(int rows, int cols, int channels, int element_size,
       channels_(channels),
       element_size_(element_size),
       scalar_size_(element_size_ / channels_) {
-  data_.resize(rows_ * cols_ * element_size_);
-  if (data) memcpy(data_.data(), data, data_.size());
+  if (data) {
+    data_.reset(new uint8_t[size()], std::default_delete<uint8_t[]>());
+    memcpy(data_.get(), data, size());
+  } else {
+    data_.reset(new uint8_t[size()](), std::default_delete<uint8_t[]>());
+  }
+}
+
+RawImageData::RawImageData(int rows, int cols, int channels, int element_size,
+                           std::shared_ptr<const void> owner,
+                           const void* data)
+    : data_(std::const_pointer_cast<void>(std::move(owner)),
+            static_cast<uint8_t*>(const_cast<void*>(data))),
+      rows_(rows),
+      cols_(cols),
+      channels_(channels),
+      element_size_(element_size),
+      scalar_size_(element_size_ / channels_) {
+  if (!data) {
+    throw std::runtime_error("RawImageData cannot alias a null buffer");
+  }
 }
 
+RawImageData::RawImageData(const RawImageData& other)
+    : RawImageData(other.rows_, other.cols_, other.channels_,
+                   other.element_size_, other.data()) {}
+
 RawImageData::RawImageData(const cv::Mat& img)
     : RawImageData(img.rows, img.cols, img.channels(), img.elemSize(),
                    img.data) {}
@@ -93,8 +125,17 @@ cv::Mat RawImageData::MakeCvImage(int cv_type) const {
   }
 
   cv::Mat ret(rows_, cols_, cv_type);
-  memcpy(ret.data, data_.data(), data_.size());
+  memcpy(ret.data, data(), size());
   return ret;
 }
 
+cv::Mat RawImageData::MakeCvImageView(int cv_type) const {
+  if (element_size_ != CV_ELEM_SIZE(cv_type) ||
+      channels_ != CV_MAT_CN(cv_type)) {
+    throw std::runtime_error("invalid conversion");
+  }
+
+  return cv::Mat(rows_, cols_, cv_type, const_cast<uint8_t*>(data()));
+}
+
 }  // namespace rs2_lcm
@@ -20,6 +20,10 @@ enum class ImageType {
   DEPTH_ALIGNED_RGB,
 };
 
+/// Number of ImageType values, for arrays indexed by ImageType.
+constexpr int kNumImageTypes =
+    static_cast<int>(ImageType::DEPTH_ALIGNED_RGB) + 1;
+
 std::string ImageTypeToString(const ImageType type);
 bool is_color_image(const ImageType type);
 bool is_depth_image(const ImageType type);
@@ -27,8 +31,12 @@ bool is_infrared_image(const ImageType type);
 
 /**
  * A primitive data storage for dense images. The underlying structure is a row
- * major std::vector<uint8_t>. Each pixel (element) can have multiple channels,
+ * major uint8_t buffer. Each pixel (element) can have multiple channels,
  * e.g. RGB image would have 3 channels, and the layout looks like RGBRGBRGB...
+ *
+ * The buffer is either owned by this object, or borrowed from an external,
+ * reference counted owner (e.g. a driver's frame handle), see
+ * WrapSharedRawImageData(). Copying a RawImageData always makes a deep copy.
  */
 class RawImageData {
  public:
@@ -39,9 +47,31 @@ class RawImageData {
         rows, cols, channels, sizeof(T) * channels, data);
   }
 
+  /**
+   * Makes a RawImageData that aliases @p data instead of copying it. @p owner
+   * is kept alive until the returned object is destroyed, and must keep
+   * @p data valid and unmodified for its lifetime.
+   */
+  template <typename T>
+  static std::shared_ptr<RawImageData> WrapSharedRawImageData(
+      int rows, int cols, int channels, std::shared_ptr<const void> owner,
+      const void* data) {
+    return std::make_shared<RawImageData>(rows, cols, channels,
+                                          sizeof(T) * channels,
+                                          std::move(owner), data);
+  }
+
+  /**
+   * Allocates @p rows * @p cols * @p element_size bytes without initializing
+   * them, for images that are about to be overwritten entirely.
+   */
+  static RawImageData MakeUninitialized(int rows, int cols, int channels,
+                                        int element_size);
+
   /**
    * Allocates @p rows * @p cols * @p element_size number of bytes, and does
-   * memcpy from @p data if it's non-null. The terminology is taken from opencv.
+   * memcpy from @p data if it's non-null, or zero fills them otherwise. The
+   * terminology is taken from opencv.
    * @p rows Height of an image.
    * @p cols Width of an image.
    * @p channels Number of scalars in each pixel (element).
@@ -50,6 +80,20 @@ class RawImageData {
   RawImageData(int rows, int cols, int channels, int element_size,
                const void* data = nullptr);
 
+  /**
+   * Aliases @p data, which holds @p rows * @p cols * @p element_size bytes,
+   * without copying. @p owner is kept alive for the lifetime of this object.
+   * The aliased memory should only be mutated if @p owner allows it.
+   */
+  RawImageData(int rows, int cols, int channels, int element_size,
+               std::shared_ptr<const void> owner, const void* data);
+
+  /**
+   * Deep copies @p other's data.
+   */
+  RawImageData(const RawImageData& other);
+  RawImageData(RawImageData&& other) = default;
+
   /**
    * Constructs an RawImageData from @p cvimg, involves deep copy of @p cvimg's
    * data.
@@ -75,7 +119,7 @@ class RawImageData {
     return Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>,
                       Eigen::RowMajor,
                       Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>(
-        reinterpret_cast<const T*>(data_.data()) + channel, rows_, cols_,
+        reinterpret_cast<const T*>(data_.get()) + channel, rows_, cols_,
         Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(channels_,
                                                       cols_ * channels_));
   }
@@ -99,7 +143,7 @@ class RawImageData {
     return Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>,
                       Eigen::RowMajor,
                       Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>(
-        reinterpret_cast<T*>(data_.data()) + channel, rows_, cols_,
+        reinterpret_cast<T*>(data_.get()) + channel, rows_, cols_,
         Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(channels_,
                                                       cols_ * channels_));
   }
@@ -112,7 +156,7 @@ class RawImageData {
   template <typename T>
   const T& at(int row, int col, int channel = 0) const {
     const int offset = ComputeOffset<T>(row, col, channel);
-    const T* addr = reinterpret_cast<const T*>(data_.data() + offset);
+    const T* addr = reinterpret_cast<const T*>(data_.get() + offset);
     return *addr;
   }
 
@@ -124,7 +168,7 @@ class RawImageData {
   template <typename T>
   T& at(int row, int col, int channel = 0) {
     const int offset = ComputeOffset<T>(row, col, channel);
-    T* addr = reinterpret_cast<T*>(data_.data() + offset);
+    T* addr = reinterpret_cast<T*>(data_.get() + offset);
     return *addr;
   }
 
@@ -136,6 +180,15 @@ class RawImageData {
    */
   cv::Mat MakeCvImage(int cv_type) const;
 
+  /**
+   * Returns a cv::Mat of @p cv_type that aliases the internal data instead of
+   * copying it. The returned cv::Mat must not outlive this object, and must
+   * not be written to.
+   * @throws if the number of channels or element size specified by
+   * @p cv_type does not match the internal values.
+   */
+  cv::Mat MakeCvImageView(int cv_type) const;
+
   int cols() const { return cols_; }
   int rows() const { return rows_; }
   int channels() const { return channels_; }
@@ -144,8 +197,13 @@ class RawImageData {
    * Returns the number of bytes per scalar.
    */
   int scalar_size() const { return scalar_size_; }
-  const uint8_t* data() const { return data_.data(); }
-  uint8_t* data() { return data_.data(); }
+
+  /**
+   * Returns the total number of bytes.
+   */
+  int size() const { return rows_ * cols_ * element_size_; }
+  const uint8_t* data() const { return data_.get(); }
+  uint8_t* data() { return data_.get(); }
 
  private:
   template <typename T>
@@ -163,7 +221,9 @@ class RawImageData {
            row * cols_ * element_size_;
   }
 
-  std::vector<uint8_t> data_;
+  // Either owns the buffer, or aliases an external buffer while sharing
+  // ownership of its owner.
+  std::shared_ptr<uint8_t> data_;
   const int rows_;
   const int cols_;
   const int channels_;
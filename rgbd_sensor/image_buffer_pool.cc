@@ -0,0 +1,84 @@
+#include "rgbd_sensor/image_buffer_pool.h"
+
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+namespace rs2_lcm {
+namespace {
+
+uint8_t* AllocateAligned(size_t size) {
+  // aligned_alloc requires the size to be a multiple of the alignment.
+  const size_t rounded = (size + ImageBufferPool::kAlignment - 1) /
+                         ImageBufferPool::kAlignment *
+                         ImageBufferPool::kAlignment;
+  void* buffer = std::aligned_alloc(ImageBufferPool::kAlignment, rounded);
+  if (!buffer) throw std::bad_alloc();
+  return static_cast<uint8_t*>(buffer);
+}
+
+}  // namespace
+
+std::shared_ptr<ImageBufferPool> ImageBufferPool::Make(size_t buffer_size,
+                                                       int max_free_buffers) {
+  return std::shared_ptr<ImageBufferPool>(
+      new ImageBufferPool(buffer_size, max_free_buffers));
+}
+
+ImageBufferPool::ImageBufferPool(size_t buffer_size, int max_free_buffers)
+    : buffer_size_(buffer_size), max_free_buffers_(max_free_buffers) {}
+
+ImageBufferPool::~ImageBufferPool() {
+  for (uint8_t* buffer : free_buffers_) std::free(buffer);
+}
+
+std::shared_ptr<uint8_t> ImageBufferPool::Acquire() {
+  uint8_t* buffer = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (!free_buffers_.empty()) {
+      buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+    }
+  }
+  if (!buffer) buffer = AllocateAligned(buffer_size_);
+
+  std::weak_ptr<ImageBufferPool> weak_pool = shared_from_this();
+  return std::shared_ptr<uint8_t>(buffer, [weak_pool](uint8_t* released) {
+    if (auto pool = weak_pool.lock()) {
+      pool->Release(released);
+    } else {
+      std::free(released);
+    }
+  });
+}
+
+std::shared_ptr<RawImageData> ImageBufferPool::MakeImage(int rows, int cols,
+                                                         int channels,
+                                                         int element_size) {
+  if (static_cast<size_t>(rows) * cols * element_size > buffer_size_) {
+    throw std::runtime_error("Image does not fit in the pooled buffers");
+  }
+  std::shared_ptr<uint8_t> buffer = Acquire();
+  const uint8_t* data = buffer.get();
+  return std::make_shared<RawImageData>(rows, cols, channels, element_size,
+                                        std::move(buffer), data);
+}
+
+int ImageBufferPool::num_free_buffers() const {
+  std::unique_lock<std::mutex> lock(lock_);
+  return free_buffers_.size();
+}
+
+void ImageBufferPool::Release(uint8_t* buffer) {
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (static_cast<int>(free_buffers_.size()) < max_free_buffers_) {
+      free_buffers_.push_back(buffer);
+      return;
+    }
+  }
+  std::free(buffer);
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rgbd_sensor/image.h"
+
+namespace rs2_lcm {
+
+/**
+ * A pool of fixed size, 64 byte aligned buffers for RawImageData. Buffers are
+ * handed out uninitialized and return to the pool when the last reference to
+ * them (or to an image wrapping them) is dropped. Buffers released after the
+ * pool has been destroyed are freed instead. Thread safe.
+ */
+class ImageBufferPool : public std::enable_shared_from_this<ImageBufferPool> {
+ public:
+  static constexpr size_t kAlignment = 64;
+
+  /**
+   * Makes a pool of buffers of @p buffer_size bytes. At most
+   * @p max_free_buffers idle buffers are retained, any extra ones are freed
+   * when released.
+   */
+  static std::shared_ptr<ImageBufferPool> Make(size_t buffer_size,
+                                               int max_free_buffers = 8);
+
+  ~ImageBufferPool();
+
+  ImageBufferPool(const ImageBufferPool&) = delete;
+  ImageBufferPool& operator=(const ImageBufferPool&) = delete;
+
+  /**
+   * Returns an uninitialized buffer of buffer_size() bytes.
+   */
+  std::shared_ptr<uint8_t> Acquire();
+
+  /**
+   * Returns an uninitialized image backed by a pooled buffer.
+   * @throws if the image does not fit in buffer_size() bytes.
+   */
+  std::shared_ptr<RawImageData> MakeImage(int rows, int cols, int channels,
+                                          int element_size);
+
+  size_t buffer_size() const { return buffer_size_; }
+
+  /**
+   * Returns the number of idle buffers.
+   */
+  int num_free_buffers() const;
+
+ private:
+  ImageBufferPool(size_t buffer_size, int max_free_buffers);
+
+  void Release(uint8_t* buffer);
+
+  const size_t buffer_size_;
+  const int max_free_buffers_;
+
+  mutable std::mutex lock_;
+  std::vector<uint8_t*> free_buffers_;
+};
+
+}  // namespace rs2_lcm
@@ -0,0 +1,510 @@
+#include "rgbd_sensor/image_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include <drake/lcmt_image.hpp>
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zlib.h>
+#include <zstd.h>
+#include "rgbd_sensor/jpeg_codec.h"
+#include "rgbd_sensor/rvl_codec.h"
+
+namespace rs2_lcm {
+namespace {
+
+void CheckSupported(const ImageCodec& codec, const RawImageData& image) {
+  if (!codec.Supports(image.channels(), image.scalar_size())) {
+    throw std::runtime_error(
+        "Compression method " + std::to_string(codec.compression_method()) +
+        " does not support images with " + std::to_string(image.channels()) +
+        " channels of " + std::to_string(image.scalar_size()) + " bytes");
+  }
+}
+
+void CheckDecodedSize(size_t size, const RawImageData& image) {
+  if (size != static_cast<size_t>(image.size())) {
+    throw std::runtime_error("Decoded image size mismatch");
+  }
+}
+
+int CvType(const RawImageData& image) {
+  return CV_MAKETYPE(image.scalar_size() == 1 ? CV_8U : CV_16U,
+                     image.channels());
+}
+
+class RawCodec : public ImageCodec {
+ public:
+  int8_t compression_method() const override {
+    return drake::lcmt_image::COMPRESSION_METHOD_NOT_COMPRESSED;
+  }
+
+  bool Supports(int, int) const override { return true; }
+
+  void Encode(const RawImageData& image, const CodecSettings&,
+              std::vector<uint8_t>* data) const override {
+    data->assign(image.data(), image.data() + image.size());
+  }
+
+  void Decode(const uint8_t* data, size_t size,
+              RawImageData* image) const override {
+    CheckDecodedSize(size, *image);
+    memcpy(image->data(), data, size);
+  }
+};
+
+class ZlibCodec : public ImageCodec {
+ public:
+  int8_t compression_method() const override {
+    return drake::lcmt_image::COMPRESSION_METHOD_ZLIB;
+  }
+
+  bool Supports(int, int) const override { return true; }
+
+  void Encode(const RawImageData& image, const CodecSettings& settings,
+              std::vector<uint8_t>* data) const override {
+    // Compress straight into @p data, sized for the worst case.
+    uLongf size = compressBound(image.size());
+    data->resize(size);
+    const int level =
+        settings.level == CodecSettings::kDefault ? Z_BEST_SPEED
+                                                  : settings.level;
+    if (compress2(data->data(), &size, image.data(), image.size(), level) !=
+        Z_OK) {
+      throw std::runtime_error("zlib compression failed");
+    }
+    data->resize(size);
+  }
+
+  void Decode(const uint8_t* data, size_t size,
+              RawImageData* image) const override {
+    uLongf decoded_size = image->size();
+    if (uncompress(image->data(), &decoded_size, data, size) != Z_OK) {
+      throw std::runtime_error("zlib decompression failed");
+    }
+    CheckDecodedSize(decoded_size, *image);
+  }
+};
+
+// Codecs implemented by OpenCV, which encodes and decodes color as BGR.
+class OpenCvCodec : public ImageCodec {
+ public:
+  void Encode(const RawImageData& image, const CodecSettings& settings,
+              std::vector<uint8_t>* data) const override {
+    CheckSupported(*this, image);
+    const cv::Mat view = image.MakeCvImageView(CvType(image));
+    const std::vector<int> params = MakeParams(settings);
+    if (image.channels() == 3) {
+      // Swapped into a per thread scratch image, which is reused across
+      // frames.
+      thread_local cv::Mat bgr;
+      cv::cvtColor(view, bgr, CV_RGB2BGR);
+      cv::imencode(extension(), bgr, *data, params);
+    } else {
+      cv::imencode(extension(), view, *data, params);
+    }
+  }
+
+  void Decode(const uint8_t* data, size_t size,
+              RawImageData* image) const override {
+    const cv::Mat decoded = cv::imdecode(
+        cv::Mat(1, size, CV_8UC1, const_cast<uint8_t*>(data)),
+        cv::IMREAD_UNCHANGED);
+    if (decoded.rows != image->rows() || decoded.cols != image->cols() ||
+        decoded.type() != CvType(*image)) {
+      throw std::runtime_error("Decoded image format mismatch");
+    }
+    cv::Mat out(image->rows(), image->cols(), CvType(*image), image->data());
+    if (image->channels() == 3) {
+      cv::cvtColor(decoded, out, CV_BGR2RGB);
+    } else {
+      memcpy(image->data(), decoded.ptr(), image->size());
+    }
+  }
+
+ protected:
+  virtual const char* extension() const = 0;
+  virtual std::vector<int> MakeParams(const CodecSettings& settings) const = 0;
+};
+
+// Encodes RGB without swapping it to BGR first, with a libjpeg compressor
+// per encoder thread that is kept across frames.
+class JpegCodec : public ImageCodec {
+ public:
+  int8_t compression_method() const override {
+    return drake::lcmt_image::COMPRESSION_METHOD_JPEG;
+  }
+
+  bool Supports(int channels, int scalar_size) const override {
+    return (channels == 1 || channels == 3) && scalar_size == 1;
+  }
+
+  void Encode(const RawImageData& image, const CodecSettings& settings,
+              std::vector<uint8_t>* data) const override {
+    CheckSupported(*this, image);
+    thread_local JpegEncoder encoder;
+    encoder.Encode(image.data(), image.cols(), image.rows(), image.channels(),
+                   Quality(settings), ToChromaSubsampling(settings.subsampling),
+                   data);
+  }
+
+  // YUYV already has 4:2:2 chroma, which is what it is encoded with unless
+  // full resolution chroma is asked for.
+  bool EncodeYuyv(const RawImageData& yuyv, const CodecSettings& settings,
+                  std::vector<uint8_t>* data) const override {
+    if (ToChromaSubsampling(settings.subsampling) ==
+        ChromaSubsampling::YUV444) {
+      return false;
+    }
+    thread_local JpegEncoder encoder;
+    encoder.EncodeYuyv(yuyv.data(), yuyv.cols(), yuyv.rows(),
+                       Quality(settings), data);
+    return true;
+  }
+
+  void Decode(const uint8_t* data, size_t size,
+              RawImageData* image) const override {
+    CheckSupported(*this, *image);
+    thread_local JpegDecoder decoder;
+    decoder.Decode(data, size, image->cols(), image->rows(), image->channels(),
+                   image->data());
+  }
+
+ private:
+  static int Quality(const CodecSettings& settings) {
+    // OpenCV's default, which encoded JPEG before.
+    return settings.quality == CodecSettings::kDefault ? 95 : settings.quality;
+  }
+
+  static ChromaSubsampling ToChromaSubsampling(int subsampling) {
+    switch (subsampling) {
+      case 444:
+        return ChromaSubsampling::YUV444;
+      case 422:
+        return ChromaSubsampling::YUV422;
+      case 420:
+      case CodecSettings::kDefault:
+        return ChromaSubsampling::YUV420;
+      default:
+        throw std::runtime_error("Unknown chroma subsampling: " +
+                                 std::to_string(subsampling));
+    }
+  }
+};
+
+class PngCodec : public OpenCvCodec {
+ public:
+  int8_t compression_method() const override {
+    return drake::lcmt_image::COMPRESSION_METHOD_PNG;
+  }
+
+  bool Supports(int channels, int scalar_size) const override {
+    return (channels == 1 || channels == 3) &&
+           (scalar_size == 1 || scalar_size == 2);
+  }
+
+ private:
+  const char* extension() const override { return ".png"; }
+
+  std::vector<int> MakeParams(const CodecSettings& settings) const override {
+    if (settings.level == CodecSettings::kDefault) return {};
+    return {cv::IMWRITE_PNG_COMPRESSION, settings.level};
+  }
+};
+
+class RvlCodec : public ImageCodec {
+ public:
+  int8_t compression_method() const override { return kCompressionMethodRvl; }
+
+  bool Supports(int channels, int scalar_size) const override {
+    return channels == 1 && scalar_size == 2;
+  }
+
+  void Encode(const RawImageData& image, const CodecSettings&,
+              std::vector<uint8_t>* data) const override {
+    CheckSupported(*this, image);
+    RvlEncode(reinterpret_cast<const uint16_t*>(image.data()),
+              image.rows() * image.cols(), data);
+  }
+
+  void Decode(const uint8_t* data, size_t size,
+              RawImageData* image) const override {
+    CheckSupported(*this, *image);
+    RvlDecode(data, size, image->rows() * image->cols(),
+              reinterpret_cast<uint16_t*>(image->data()));
+  }
+};
+
+// Splits the @p count scalars of @p scalar_size bytes at @p in into planes
+// of their first, second, ... bytes at @p out.
+void ShuffleBytes(const uint8_t* in, size_t count, int scalar_size,
+                  uint8_t* out) {
+  for (int b = 0; b < scalar_size; b++) {
+    uint8_t* plane = out + b * count;
+    for (size_t i = 0; i < count; i++) plane[i] = in[i * scalar_size + b];
+  }
+}
+
+// Inverts ShuffleBytes().
+void UnshuffleBytes(const uint8_t* in, size_t count, int scalar_size,
+                    uint8_t* out) {
+  for (int b = 0; b < scalar_size; b++) {
+    const uint8_t* plane = in + b * count;
+    for (size_t i = 0; i < count; i++) out[i * scalar_size + b] = plane[i];
+  }
+}
+
+// Codecs which compress the image as a byte stream. The stream starts with
+// a byte of flags, which tell the decoder whether the image was shuffled.
+class ByteStreamCodec : public ImageCodec {
+ public:
+  bool Supports(int, int) const override { return true; }
+
+  void Encode(const RawImageData& image, const CodecSettings& settings,
+              std::vector<uint8_t>* data) const override {
+    // Shuffling is on unless it is turned off.
+    const bool shuffle = image.scalar_size() > 1 && settings.shuffle != 0;
+    const uint8_t* input = image.data();
+    if (shuffle) {
+      thread_local std::vector<uint8_t> shuffled;
+      shuffled.resize(image.size());
+      ShuffleBytes(image.data(), image.size() / image.scalar_size(),
+                   image.scalar_size(), shuffled.data());
+      input = shuffled.data();
+    }
+
+    // Compress straight into @p data, sized for the worst case.
+    data->resize(1 + MaxCompressedSize(image.size()));
+    (*data)[0] = shuffle ? kShuffled : 0;
+    const size_t size = Compress(input, image.size(), settings,
+                                 data->data() + 1, data->size() - 1);
+    data->resize(1 + size);
+  }
+
+  void Decode(const uint8_t* data, size_t size,
+              RawImageData* image) const override {
+    if (size < 1 || (data[0] & ~kShuffled) != 0) {
+      throw std::runtime_error("Invalid compressed image header");
+    }
+    if ((data[0] & kShuffled) == 0) {
+      Decompress(data + 1, size - 1, image->data(), image->size());
+      return;
+    }
+    thread_local std::vector<uint8_t> shuffled;
+    shuffled.resize(image->size());
+    Decompress(data + 1, size - 1, shuffled.data(), shuffled.size());
+    UnshuffleBytes(shuffled.data(), image->size() / image->scalar_size(),
+                   image->scalar_size(), image->data());
+  }
+
+ protected:
+  virtual size_t MaxCompressedSize(size_t size) const = 0;
+
+  // Compresses the @p size bytes at @p in into the @p capacity bytes at
+  // @p out, and returns the compressed size.
+  virtual size_t Compress(const uint8_t* in, size_t size,
+                          const CodecSettings& settings, uint8_t* out,
+                          size_t capacity) const = 0;
+
+  // Decompresses exactly @p out_size bytes.
+  virtual void Decompress(const uint8_t* in, size_t size, uint8_t* out,
+                          size_t out_size) const = 0;
+
+ private:
+  static constexpr uint8_t kShuffled = 1;
+};
+
+// Levels from LZ4HC_CLEVEL_MIN up use the slower high compression
+// compressor, lower ones the fast one. Negative levels -N speed that one up
+// with acceleration N, like `lz4 --fast=N`, at the cost of ratio, while the
+// levels in between all compress like the default.
+class Lz4Codec : public ByteStreamCodec {
+ public:
+  int8_t compression_method() const override { return kCompressionMethodLz4; }
+
+ private:
+  size_t MaxCompressedSize(size_t size) const override {
+    return LZ4_compressBound(size);
+  }
+
+  size_t Compress(const uint8_t* in, size_t size,
+                  const CodecSettings& settings, uint8_t* out,
+                  size_t capacity) const override {
+    // The compression state of each encoder thread is kept across frames.
+    int compressed_size = 0;
+    if (settings.level >= LZ4HC_CLEVEL_MIN) {
+      thread_local std::unique_ptr<LZ4_streamHC_t, int (*)(LZ4_streamHC_t*)>
+          state(LZ4_createStreamHC(), LZ4_freeStreamHC);
+      compressed_size = LZ4_compress_HC_extStateHC(
+          state.get(), reinterpret_cast<const char*>(in),
+          reinterpret_cast<char*>(out), size, capacity, settings.level);
+    } else {
+      thread_local std::unique_ptr<LZ4_stream_t, int (*)(LZ4_stream_t*)>
+          state(LZ4_createStream(), LZ4_freeStream);
+      // Also 1 for CodecSettings::kDefault.
+      const int acceleration = settings.level < 0 ? -settings.level : 1;
+      compressed_size = LZ4_compress_fast_extState(
+          state.get(), reinterpret_cast<const char*>(in),
+          reinterpret_cast<char*>(out), size, capacity, acceleration);
+    }
+    if (compressed_size <= 0) {
+      throw std::runtime_error("LZ4 compression failed");
+    }
+    return compressed_size;
+  }
+
+  void Decompress(const uint8_t* in, size_t size, uint8_t* out,
+                  size_t out_size) const override {
+    const int decompressed_size = LZ4_decompress_safe(
+        reinterpret_cast<const char*>(in), reinterpret_cast<char*>(out), size,
+        out_size);
+    if (decompressed_size < 0) {
+      throw std::runtime_error("LZ4 decompression failed");
+    }
+    if (static_cast<size_t>(decompressed_size) != out_size) {
+      throw std::runtime_error("Decoded image size mismatch");
+    }
+  }
+};
+
+void CheckZstd(size_t result, const char* what) {
+  if (ZSTD_isError(result)) {
+    throw std::runtime_error(std::string(what) + " failed: " +
+                             ZSTD_getErrorName(result));
+  }
+}
+
+class ZstdCodec : public ByteStreamCodec {
+ public:
+  int8_t compression_method() const override {
+    return kCompressionMethodZstd;
+  }
+
+ private:
+  size_t MaxCompressedSize(size_t size) const override {
+    return ZSTD_compressBound(size);
+  }
+
+  size_t Compress(const uint8_t* in, size_t size,
+                  const CodecSettings& settings, uint8_t* out,
+                  size_t capacity) const override {
+    // The context of each encoder thread is kept across frames, which saves
+    // reallocating its tables.
+    thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> context(
+        ZSTD_createCCtx(), ZSTD_freeCCtx);
+    const int level =
+        settings.level == CodecSettings::kDefault ? 1 : settings.level;
+    CheckZstd(ZSTD_CCtx_setParameter(context.get(), ZSTD_c_compressionLevel,
+                                     level),
+              "Setting the zstd level");
+    // Only libzstd built with multithreading supports workers, otherwise the
+    // image is compressed on this thread.
+    ZSTD_CCtx_setParameter(context.get(), ZSTD_c_nbWorkers,
+                           settings.threads > 1 ? settings.threads : 0);
+    const size_t compressed_size =
+        ZSTD_compress2(context.get(), out, capacity, in, size);
+    CheckZstd(compressed_size, "zstd compression");
+    return compressed_size;
+  }
+
+  void Decompress(const uint8_t* in, size_t size, uint8_t* out,
+                  size_t out_size) const override {
+    thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(
+        ZSTD_createDCtx(), ZSTD_freeDCtx);
+    const size_t decompressed_size =
+        ZSTD_decompressDCtx(context.get(), out, out_size, in, size);
+    CheckZstd(decompressed_size, "zstd decompression");
+    if (decompressed_size != out_size) {
+      throw std::runtime_error("Decoded image size mismatch");
+    }
+  }
+};
+
+class Registry {
+ public:
+  static Registry& Get() {
+    static Registry* registry = new Registry();
+    return *registry;
+  }
+
+  void Register(const std::string& name,
+                std::shared_ptr<const ImageCodec> codec) {
+    std::unique_lock<std::mutex> lock(lock_);
+    const int8_t method = codec->compression_method();
+    for (auto it = codecs_.begin(); it != codecs_.end();) {
+      if (it->second->compression_method() == method) {
+        it = codecs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    codecs_[name] = std::move(codec);
+  }
+
+  std::shared_ptr<const ImageCodec> Find(const std::string& name) const {
+    std::unique_lock<std::mutex> lock(lock_);
+    auto it = codecs_.find(name);
+    if (it == codecs_.end()) {
+      throw std::runtime_error("Unknown image codec: " + name);
+    }
+    return it->second;
+  }
+
+  std::shared_ptr<const ImageCodec> Find(int8_t method) const {
+    std::unique_lock<std::mutex> lock(lock_);
+    for (const auto& codec : codecs_) {
+      if (codec.second->compression_method() == method) return codec.second;
+    }
+    throw std::runtime_error("No image codec for compression method " +
+                             std::to_string(method));
+  }
+
+  std::vector<std::string> Names() const {
+    std::unique_lock<std::mutex> lock(lock_);
+    std::vector<std::string> names;
+    for (const auto& codec : codecs_) names.push_back(codec.first);
+    return names;
+  }
+
+ private:
+  Registry() {
+    Register("raw", std::make_shared<RawCodec>());
+    Register("zlib", std::make_shared<ZlibCodec>());
+    Register("jpeg", std::make_shared<JpegCodec>());
+    Register("png", std::make_shared<PngCodec>());
+    Register("rvl", std::make_shared<RvlCodec>());
+    Register("lz4", std::make_shared<Lz4Codec>());
+    Register("zstd", std::make_shared<ZstdCodec>());
+  }
+
+  mutable std::mutex lock_;
+  std::map<std::string, std::shared_ptr<const ImageCodec>> codecs_;
+};
+
+}  // namespace
+
+void RegisterImageCodec(const std::string& name,
+                        std::shared_ptr<const ImageCodec> codec) {
+  if (!codec) throw std::runtime_error("Null image codec: " + name);
+  Registry::Get().Register(name, std::move(codec));
+}
+
+std::shared_ptr<const ImageCodec> GetImageCodec(const std::string& name) {
+  return Registry::Get().Find(name);
+}
+
+std::shared_ptr<const ImageCodec> GetImageCodecForMethod(
+    int8_t compression_method) {
+  return Registry::Get().Find(compression_method);
+}
+
+std::vector<std::string> GetImageCodecNames() {
+  return Registry::Get().Names();
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rgbd_sensor/image.h"
+
+namespace rs2_lcm {
+
+/// How the images of one stream are encoded, see ImageCodec.
+struct CodecSettings {
+  /// Leaves a setting to the codec.
+  static constexpr int kDefault = -1;
+
+  /// Name of the codec, see GetImageCodec().
+  std::string codec;
+  /// Codec specific compression level.
+  int level{kDefault};
+  /// Quality of lossy codecs, in [0, 100].
+  int quality{kDefault};
+  /// Number of threads for codecs that can split up an image. The images of
+  /// a frameset are already encoded in parallel with each other.
+  int threads{kDefault};
+  /// Whether general purpose codecs group the bytes of multi byte scalars,
+  /// so that the slowly changing high bytes compress together. 0 or 1, by
+  /// default on for 16 bit images.
+  int shuffle{kDefault};
+  /// Chroma subsampling of lossy color codecs: 444, 422 or 420 (the
+  /// default).
+  int subsampling{kDefault};
+};
+
+/// lcmt_image::compression_method of images encoded with LZ4.
+constexpr int8_t kCompressionMethodLz4 = 101;
+/// lcmt_image::compression_method of images encoded with zstd.
+constexpr int8_t kCompressionMethodZstd = 102;
+
+/**
+ * Compresses images into the data of lcmt_image messages, and back. One
+ * codec encodes the images of every stream and camera, so implementations
+ * must be thread safe.
+ */
+class ImageCodec {
+ public:
+  virtual ~ImageCodec() = default;
+
+  /// The lcmt_image::compression_method of the encoded images.
+  virtual int8_t compression_method() const = 0;
+
+  /// Returns true if images with @p channels scalars of @p scalar_size bytes
+  /// per pixel can be encoded.
+  virtual bool Supports(int channels, int scalar_size) const = 0;
+
+  /**
+   * Encodes @p image into @p data, reusing its capacity. 3 channel images
+   * are RGB.
+   * @throws std::runtime_error if the image is not supported, or encoding
+   * fails.
+   */
+  virtual void Encode(const RawImageData& image, const CodecSettings& settings,
+                      std::vector<uint8_t>* data) const = 0;
+
+  /**
+   * Encodes @p yuyv, a color image captured as YUYV (see YuyvColorImage),
+   * into @p data the same way Encode() encodes its RGB conversion, but
+   * without converting it. Returns false if the codec can not, in which case
+   * the image has to be converted to RGB and passed to Encode().
+   */
+  virtual bool EncodeYuyv(const RawImageData& yuyv,
+                          const CodecSettings& settings,
+                          std::vector<uint8_t>* data) const {
+    return false;
+  }
+
+  /**
+   * Decodes the @p size bytes of @p data into @p image, which must already
+   * have the dimensions and format of the encoded image.
+   * @throws std::runtime_error if @p data does not decode to such an image.
+   */
+  virtual void Decode(const uint8_t* data, size_t size,
+                      RawImageData* image) const = 0;
+};
+
+/**
+ * Registers @p codec under @p name, replacing any codec with that name or
+ * compression method. "raw", "zlib", "jpeg", "png", "rvl", "lz4" and "zstd"
+ * are built in.
+ */
+void RegisterImageCodec(const std::string& name,
+                        std::shared_ptr<const ImageCodec> codec);
+
+/**
+ * @throws std::runtime_error if no codec is registered under @p name.
+ */
+std::shared_ptr<const ImageCodec> GetImageCodec(const std::string& name);
+
+/**
+ * Returns the codec that decodes images of @p compression_method.
+ * @throws std::runtime_error if there is none.
+ */
+std::shared_ptr<const ImageCodec> GetImageCodecForMethod(
+    int8_t compression_method);
+
+/// Returns the names of all registered codecs, sorted.
+std::vector<std::string> GetImageCodecNames();
+
+}  // namespace rs2_lcm
@@ -0,0 +1,138 @@
+#include "rgbd_sensor/image_conversions.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace rs2_lcm {
+
+void WidenY8ToY16(const uint8_t* src, int src_stride, int width, int height,
+                  uint16_t* dst) {
+  for (int y = 0; y < height; y++) {
+    const uint8_t* src_row = src + y * src_stride;
+    uint16_t* dst_row = dst + y * width;
+    int x = 0;
+#if defined(__AVX2__)
+    for (; x + 16 <= width; x += 16) {
+      const __m128i in =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + x));
+      const __m256i out = _mm256_slli_epi16(_mm256_cvtepu8_epi16(in), 8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst_row + x), out);
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+      const __m128i in =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + x));
+      // Interleaving zeros below each byte puts it in the high byte.
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst_row + x),
+                       _mm_unpacklo_epi8(zero, in));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst_row + x + 8),
+                       _mm_unpackhi_epi8(zero, in));
+    }
+#endif
+    for (; x < width; x++) {
+      dst_row[x] = static_cast<uint16_t>(src_row[x] << 8);
+    }
+  }
+}
+
+void ScaleDepth(const uint16_t* src, int src_stride, int width, int height,
+                float scale, uint16_t* dst) {
+  const float kMaxDepth = 65535.f;
+  for (int y = 0; y < height; y++) {
+    const uint16_t* src_row = reinterpret_cast<const uint16_t*>(
+        reinterpret_cast<const uint8_t*>(src) + y * src_stride);
+    uint16_t* dst_row = dst + y * width;
+    if (scale == 1.f) {
+      memcpy(dst_row, src_row, width * sizeof(uint16_t));
+      continue;
+    }
+
+    int x = 0;
+#if defined(__AVX2__)
+    const __m256 scale8 = _mm256_set1_ps(scale);
+    const __m256 max8 = _mm256_set1_ps(kMaxDepth);
+    for (; x + 16 <= width; x += 16) {
+      const __m128i lo =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + x));
+      const __m128i hi =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + x + 8));
+      const __m256 lo_f = _mm256_min_ps(
+          _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(lo)), scale8),
+          max8);
+      const __m256 hi_f = _mm256_min_ps(
+          _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(hi)), scale8),
+          max8);
+      // packus works per 128 bit lane, so the 64 bit blocks need reordering.
+      const __m256i packed = _mm256_packus_epi32(_mm256_cvttps_epi32(lo_f),
+                                                 _mm256_cvttps_epi32(hi_f));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst_row + x),
+                          _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 max4 = _mm_set1_ps(kMaxDepth);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(-32768);
+    for (; x + 8 <= width; x += 8) {
+      const __m128i in =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + x));
+      const __m128 lo_f = _mm_min_ps(
+          _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(in, zero)), scale4),
+          max4);
+      const __m128 hi_f = _mm_min_ps(
+          _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(in, zero)), scale4),
+          max4);
+      // SSE2 only has a signed 32 -> 16 bit pack, so shift the values into
+      // the signed range and back.
+      const __m128i lo = _mm_sub_epi32(_mm_cvttps_epi32(lo_f), bias32);
+      const __m128i hi = _mm_sub_epi32(_mm_cvttps_epi32(hi_f), bias32);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst_row + x),
+                       _mm_xor_si128(_mm_packs_epi32(lo, hi), bias16));
+    }
+#endif
+    for (; x < width; x++) {
+      dst_row[x] =
+          static_cast<uint16_t>(std::min(src_row[x] * scale, kMaxDepth));
+    }
+  }
+}
+
+namespace {
+
+uint8_t Clamp8(int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+}  // namespace
+
+void YuyvToRgb(const uint8_t* src, int src_stride, int width, int height,
+               uint8_t* dst) {
+  for (int y = 0; y < height; y++) {
+    const uint8_t* src_row = src + y * src_stride;
+    uint8_t* dst_row = dst + y * width * 3;
+    for (int x = 0; x < width; x += 2) {
+      const uint8_t* in = src_row + x * 2;
+      const int d = in[1] - 128;
+      const int e = in[3] - 128;
+      // The chroma terms are shared by both pixels of the pair.
+      const int r = 409 * e + 128;
+      const int g = -100 * d - 208 * e + 128;
+      const int b = 516 * d + 128;
+      for (int i = 0; i < 2; i++) {
+        const int c = 298 * (in[i * 2] - 16);
+        uint8_t* out = dst_row + (x + i) * 3;
+        out[0] = Clamp8((c + r) >> 8);
+        out[1] = Clamp8((c + g) >> 8);
+        out[2] = Clamp8((c + b) >> 8);
+      }
+    }
+  }
+}
+
+}  // namespace rs2_lcm
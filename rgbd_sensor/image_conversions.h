@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+namespace rs2_lcm {
+
+/**
+ * Pixel conversion kernels used when copying frames out of a driver's
+ * buffers. All kernels walk the images row major. The source may have padded
+ * rows (@p src_stride is in bytes), the destination is always densely packed.
+ * SSE2 / AVX2 code paths are selected at compile time, with a scalar
+ * fallback.
+ */
+
+/**
+ * Widens an 8 bit single channel image to 16 bits, i.e. dst = src * 256.
+ */
+void WidenY8ToY16(const uint8_t* src, int src_stride, int width, int height,
+                  uint16_t* dst);
+
+/**
+ * Rescales a 16 bit depth image by @p scale, e.g. from device depth units to
+ * millimeters. The result is truncated towards zero, and saturates at 65535
+ * instead of overflowing. A @p scale of 1 reduces to a plain copy.
+ */
+void ScaleDepth(const uint16_t* src, int src_stride, int width, int height,
+                float scale, uint16_t* dst);
+
+/**
+ * Converts a YUYV (YUY2) image, where each pair of pixels is stored as
+ * Y0 U Y1 V, to RGB. The YUV is BT.601 video range, as cameras deliver it,
+ * and converted with the same fixed point arithmetic as librealsense's own
+ * RGB8 output. @p width must be even.
+ */
+void YuyvToRgb(const uint8_t* src, int src_stride, int width, int height,
+               uint8_t* dst);
+
+}  // namespace rs2_lcm
@@ -0,0 +1,86 @@
+#include "rgbd_sensor/image_history.h"
+
+#include <utility>
+
+namespace rs2_lcm {
+
+ImageHistory::ImageHistory(int capacity) { Reset(capacity); }
+
+void ImageHistory::Reset(int capacity) {
+  std::unique_lock<std::mutex> lock(lock_);
+  entries_.clear();
+  entries_.resize(capacity);
+  begin_ = 0;
+  size_ = 0;
+}
+
+void ImageHistory::Push(uint64_t timestamp,
+                        std::shared_ptr<const RawImageData> image) {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (entries_.empty()) return;
+  if (size_ > 0 && timestamp < at(size_ - 1).timestamp) {
+    for (Entry& entry : entries_) entry = Entry();
+    begin_ = 0;
+    size_ = 0;
+  }
+
+  const int capacity = entries_.size();
+  Entry& slot = entries_[(begin_ + size_) % capacity];
+  slot.timestamp = timestamp;
+  slot.image = std::move(image);
+  if (size_ < capacity) {
+    size_++;
+  } else {
+    begin_ = (begin_ + 1) % capacity;
+  }
+}
+
+ImageHistory::Entry ImageHistory::GetNearest(uint64_t timestamp) const {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (size_ == 0) return Entry();
+
+  const int i = LowerBound(timestamp);
+  if (i == 0) return at(0);
+  if (i == size_) return at(size_ - 1);
+  const Entry& before = at(i - 1);
+  const Entry& after = at(i);
+  return (timestamp - before.timestamp <= after.timestamp - timestamp)
+             ? before
+             : after;
+}
+
+std::vector<ImageHistory::Entry> ImageHistory::GetInRange(
+    uint64_t begin, uint64_t end) const {
+  std::vector<Entry> ret;
+  std::unique_lock<std::mutex> lock(lock_);
+  for (int i = LowerBound(begin); i < size_ && at(i).timestamp <= end; i++) {
+    ret.push_back(at(i));
+  }
+  return ret;
+}
+
+int ImageHistory::capacity() const {
+  std::unique_lock<std::mutex> lock(lock_);
+  return entries_.size();
+}
+
+int ImageHistory::size() const {
+  std::unique_lock<std::mutex> lock(lock_);
+  return size_;
+}
+
+int ImageHistory::LowerBound(uint64_t timestamp) const {
+  int lo = 0;
+  int hi = size_;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (at(mid).timestamp < timestamp) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+}  // namespace rs2_lcm
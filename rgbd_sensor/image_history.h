@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rgbd_sensor/image.h"
+
+namespace rs2_lcm {
+
+/**
+ * A fixed capacity ring buffer of the most recent images of one stream,
+ * ordered by timestamp. Images are shared, never copied. Thread safe; the
+ * lock is only held for O(log N) lookups and O(1) insertions.
+ */
+class ImageHistory {
+ public:
+  struct Entry {
+    uint64_t timestamp{0};
+    std::shared_ptr<const RawImageData> image;
+  };
+
+  explicit ImageHistory(int capacity = 0);
+
+  /**
+   * Drops all images and preallocates room for @p capacity images.
+   */
+  void Reset(int capacity);
+
+  /**
+   * Adds @p image, evicting the oldest image when full. Timestamps are
+   * expected to be non decreasing; an older timestamp (e.g. after the device
+   * clock was reset) clears the history first.
+   */
+  void Push(uint64_t timestamp, std::shared_ptr<const RawImageData> image);
+
+  /**
+   * Returns the image whose timestamp is closest to @p timestamp, preferring
+   * the older one on ties, or an entry with a nullptr image if empty.
+   */
+  Entry GetNearest(uint64_t timestamp) const;
+
+  /**
+   * Returns all images with timestamps in [@p begin, @p end], oldest first.
+   */
+  std::vector<Entry> GetInRange(uint64_t begin, uint64_t end) const;
+
+  int capacity() const;
+  int size() const;
+
+ private:
+  // Returns the logical index of the first entry with a timestamp not less
+  // than @p timestamp, or size_ if there is none. Requires lock_.
+  int LowerBound(uint64_t timestamp) const;
+
+  // Returns the entry at logical index @p i, where 0 is the oldest. Requires
+  // lock_.
+  const Entry& at(int i) const {
+    return entries_[(begin_ + i) % entries_.size()];
+  }
+
+  mutable std::mutex lock_;
+  std::vector<Entry> entries_;
+  int begin_{0};
+  int size_{0};
+};
+
+}  // namespace rs2_lcm
@@ -1,6 +1,8 @@
 #include "rgbd_sensor/intrinsics.h"
 
 #include <array>
+#include <cmath>
+#include <stdexcept>
 
 #include <Eigen/Core>
 
@@ -26,51 +28,200 @@ Intrinsics::Intrinsics(int width, int height, const Eigen::Matrix3f& intrinsics)
     : Intrinsics(width, height, intrinsics(0, 0), intrinsics(1, 1),
                  intrinsics(0, 2), intrinsics(1, 2)) {}
 
-Eigen::Vector2f Intrinsics::Project(const Eigen::Vector3f& point) const {
-  float x = point[0] / point[2];
-  float y = point[1] / point[2];
-
-  if (model_ == DistortionModel::MODIFIED_BROWN_CONRADY) {
-    float r2 = x * x + y * y;
-    float f =
-        1 + coeffs_[0] * r2 + coeffs_[1] * r2 * r2 + coeffs_[4] * r2 * r2 * r2;
-    x *= f;
-    y *= f;
-    float dx = x + 2 * coeffs_[2] * x * y + coeffs_[3] * (r2 + 2 * x * x);
-    float dy = y + 2 * coeffs_[3] * x * y + coeffs_[2] * (r2 + 2 * y * y);
-    x = dx;
-    y = dy;
-  } else if (model_ == DistortionModel::FTHETA) {
-    float r = sqrt(x * x + y * y);
-    float rd = (1.0f / coeffs_[0] * atan(2 * r * tan(coeffs_[0] / 2.0f)));
-    x *= rd / r;
-    y *= rd / r;
+namespace {
+
+typedef Intrinsics::DistortionModel Model;
+
+// Number of fixed point iterations that invert the Brown-Conrady models.
+// Converges well below a hundredth of a pixel for lens distortion of the
+// magnitude found in the RealSense color cameras.
+constexpr int kUndistortIterations = 10;
+
+// Brown-Conrady radial factor, with k1, k2 and k3 in coeffs[0, 1, 4].
+inline float RadialFactor(const std::array<float, 5>& c, float r2) {
+  return 1 + c[0] * r2 + c[1] * r2 * r2 + c[4] * r2 * r2 * r2;
+}
+
+// Brown-Conrady tangential offset of (@p x, @p y), whose squared radius is
+// @p r2, with p1 and p2 in coeffs[2, 3].
+inline void TangentialOffset(const std::array<float, 5>& c, float x, float y,
+                             float r2, float* dx, float* dy) {
+  *dx = 2 * c[2] * x * y + c[3] * (r2 + 2 * x * x);
+  *dy = 2 * c[3] * x * y + c[2] * (r2 + 2 * y * y);
+}
+
+// FTHETA's ratio of distorted to undistorted radius, at radius @p r.
+inline float FthetaDistortRatio(float w, float r) {
+  const float k = 2 * std::tan(w / 2);
+  // The limit as r goes to 0.
+  if (r < 1e-7f) return k / w;
+  return std::atan(r * k) / (w * r);
+}
+
+// FTHETA's ratio of undistorted to distorted radius, at distorted radius
+// @p rd.
+inline float FthetaUndistortRatio(float w, float rd) {
+  const float k = 2 * std::tan(w / 2);
+  if (rd < 1e-7f) return w / k;
+  return std::tan(rd * w) / (k * rd);
+}
+
+// Applies the projection distortion of kModel to the normalized image
+// coordinates (@p x, @p y).
+template <Model kModel>
+inline void Distort(const std::array<float, 5>& c, float* x, float* y) {
+  if (kModel == Model::MODIFIED_BROWN_CONRADY) {
+    const float r2 = *x * *x + *y * *y;
+    const float f = RadialFactor(c, r2);
+    const float xf = *x * f;
+    const float yf = *y * f;
+    float dx, dy;
+    TangentialOffset(c, xf, yf, r2, &dx, &dy);
+    *x = xf + dx;
+    *y = yf + dy;
+  } else if (kModel == Model::BROWN_CONRADY) {
+    const float r2 = *x * *x + *y * *y;
+    const float f = RadialFactor(c, r2);
+    float dx, dy;
+    TangentialOffset(c, *x, *y, r2, &dx, &dy);
+    *x = *x * f + dx;
+    *y = *y * f + dy;
+  } else if (kModel == Model::FTHETA) {
+    const float ratio = FthetaDistortRatio(c[0], std::sqrt(*x * *x + *y * *y));
+    *x *= ratio;
+    *y *= ratio;
   }
+  // NONE has no distortion, and INVERSE_BROWN_CONRADY only describes the
+  // distortion of back projection.
+}
 
-  return Eigen::Vector2f(x * fx_ + ppx_, y * fy_ + ppy_);
+// Inverts Distort<kModel>(), and applies the back projection distortion of
+// INVERSE_BROWN_CONRADY.
+template <Model kModel>
+inline void Undistort(const std::array<float, 5>& c, float* x, float* y) {
+  if (kModel == Model::INVERSE_BROWN_CONRADY) {
+    const float r2 = *x * *x + *y * *y;
+    const float f = RadialFactor(c, r2);
+    float dx, dy;
+    TangentialOffset(c, *x, *y, r2, &dx, &dy);
+    *x = *x * f + dx;
+    *y = *y * f + dy;
+  } else if (kModel == Model::MODIFIED_BROWN_CONRADY ||
+             kModel == Model::BROWN_CONRADY) {
+    // Fixed point iteration on x = (xd - tangential(x)) / radial(x), where
+    // the tangential offset is taken after (MODIFIED_BROWN_CONRADY) or before
+    // (BROWN_CONRADY) the radial scaling.
+    const float xd = *x;
+    const float yd = *y;
+    float ux = xd;
+    float uy = yd;
+    for (int i = 0; i < kUndistortIterations; i++) {
+      const float r2 = ux * ux + uy * uy;
+      const float f = RadialFactor(c, r2);
+      float dx, dy;
+      if (kModel == Model::MODIFIED_BROWN_CONRADY) {
+        TangentialOffset(c, ux * f, uy * f, r2, &dx, &dy);
+      } else {
+        TangentialOffset(c, ux, uy, r2, &dx, &dy);
+      }
+      ux = (xd - dx) / f;
+      uy = (yd - dy) / f;
+    }
+    *x = ux;
+    *y = uy;
+  } else if (kModel == Model::FTHETA) {
+    const float ratio =
+        FthetaUndistortRatio(c[0], std::sqrt(*x * *x + *y * *y));
+    *x *= ratio;
+    *y *= ratio;
+  }
+}
+
+template <Model kModel>
+void ProjectKernel(const Intrinsics& in, const float* x, const float* y,
+                   const float* z, int size, float* u, float* v) {
+  const std::array<float, 5>& c = in.distortion_coeffs();
+  const float fx = in.fx(), fy = in.fy(), ppx = in.ppx(), ppy = in.ppy();
+  for (int i = 0; i < size; i++) {
+    float px = x[i] / z[i];
+    float py = y[i] / z[i];
+    Distort<kModel>(c, &px, &py);
+    u[i] = px * fx + ppx;
+    v[i] = py * fy + ppy;
+  }
+}
+
+template <Model kModel>
+void BackProjectKernel(const Intrinsics& in, const float* u, const float* v,
+                       const float* depth, int size, float* x, float* y,
+                       float* z) {
+  const std::array<float, 5>& c = in.distortion_coeffs();
+  const float fx = in.fx(), fy = in.fy(), ppx = in.ppx(), ppy = in.ppy();
+  for (int i = 0; i < size; i++) {
+    float px = (u[i] - ppx) / fx;
+    float py = (v[i] - ppy) / fy;
+    Undistort<kModel>(c, &px, &py);
+    const float d = depth ? depth[i] : 1.f;
+    x[i] = d * px;
+    y[i] = d * py;
+    if (z) z[i] = d;
+  }
+}
+
+}  // namespace
+
+Eigen::Vector2f Intrinsics::Project(const Eigen::Vector3f& point) const {
+  Eigen::Vector2f pixel;
+  ProjectBatch(&point[0], &point[1], &point[2], 1, &pixel[0], &pixel[1]);
+  return pixel;
 }
 
 Eigen::Vector3f Intrinsics::BackProject(const Eigen::Vector2f& pixel,
                                         float depth) const {
-  if (model_ == DistortionModel::MODIFIED_BROWN_CONRADY) {
-    throw std::runtime_error("Cannot back project with MODIFIED_BROWN_CONRADY");
-  }
-  if (model_ == DistortionModel::FTHETA) {
-    throw std::runtime_error("Cannot back project with FTHETA");
+  Eigen::Vector3f point;
+  BackProjectBatch(&pixel[0], &pixel[1], &depth, 1, &point[0], &point[1],
+                   &point[2]);
+  return point;
+}
+
+void Intrinsics::ProjectBatch(const float* x, const float* y, const float* z,
+                              int size, float* u, float* v) const {
+  switch (model_) {
+    case DistortionModel::NONE:
+    case DistortionModel::INVERSE_BROWN_CONRADY:
+      return ProjectKernel<Model::NONE>(*this, x, y, z, size, u, v);
+    case DistortionModel::MODIFIED_BROWN_CONRADY:
+      return ProjectKernel<Model::MODIFIED_BROWN_CONRADY>(*this, x, y, z,
+                                                          size, u, v);
+    case DistortionModel::FTHETA:
+      return ProjectKernel<Model::FTHETA>(*this, x, y, z, size, u, v);
+    case DistortionModel::BROWN_CONRADY:
+      return ProjectKernel<Model::BROWN_CONRADY>(*this, x, y, z, size, u, v);
   }
+  throw std::runtime_error("Invalid DistortionModel");
+}
 
-  float x = (pixel[0] - ppx_) / fx_;
-  float y = (pixel[1] - ppy_) / fy_;
-  if (model_ == DistortionModel::INVERSE_BROWN_CONRADY) {
-    float r2 = x * x + y * y;
-    float f =
-        1 + coeffs_[0] * r2 + coeffs_[1] * r2 * r2 + coeffs_[4] * r2 * r2 * r2;
-    float ux = x * f + 2 * coeffs_[2] * x * y + coeffs_[3] * (r2 + 2 * x * x);
-    float uy = y * f + 2 * coeffs_[3] * x * y + coeffs_[2] * (r2 + 2 * y * y);
-    x = ux;
-    y = uy;
+void Intrinsics::BackProjectBatch(const float* u, const float* v,
+                                  const float* depth, int size, float* x,
+                                  float* y, float* z) const {
+  switch (model_) {
+    case DistortionModel::NONE:
+      return BackProjectKernel<Model::NONE>(*this, u, v, depth, size, x, y,
+                                            z);
+    case DistortionModel::MODIFIED_BROWN_CONRADY:
+      return BackProjectKernel<Model::MODIFIED_BROWN_CONRADY>(
+          *this, u, v, depth, size, x, y, z);
+    case DistortionModel::INVERSE_BROWN_CONRADY:
+      return BackProjectKernel<Model::INVERSE_BROWN_CONRADY>(
+          *this, u, v, depth, size, x, y, z);
+    case DistortionModel::FTHETA:
+      return BackProjectKernel<Model::FTHETA>(*this, u, v, depth, size, x, y,
+                                              z);
+    case DistortionModel::BROWN_CONRADY:
+      return BackProjectKernel<Model::BROWN_CONRADY>(*this, u, v, depth, size,
+                                                     x, y, z);
   }
-  return Eigen::Vector3f(depth * x, depth * y, depth);
+  throw std::runtime_error("Invalid DistortionModel");
 }
 
 std::ostream& operator<<(std::ostream& os, const Intrinsics& in) {
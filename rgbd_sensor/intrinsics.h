@@ -45,9 +45,29 @@ class Intrinsics {
 
   /**
    * Reconstruct a 3D point from a pixel and its associated depth value.
+   * Models that only describe projection distortion (MODIFIED_BROWN_CONRADY,
+   * BROWN_CONRADY) are inverted iteratively, FTHETA in closed form.
    */
   Eigen::Vector3f BackProject(const Eigen::Vector2f& pixel, float depth) const;
 
+  /**
+   * Same as Project() for the @p size points (@p x[i], @p y[i], @p z[i]),
+   * writing the pixels to (@p u[i], @p v[i]). The distortion model is
+   * dispatched once for the whole batch.
+   */
+  void ProjectBatch(const float* x, const float* y, const float* z, int size,
+                    float* u, float* v) const;
+
+  /**
+   * Same as BackProject() for the @p size pixels (@p u[i], @p v[i]) at
+   * depths @p depth[i], writing the points to (@p x[i], @p y[i], @p z[i]).
+   * If @p depth is nullptr, every depth is 1 and @p z may be nullptr too,
+   * which gives the rays through the pixels. The distortion model is
+   * dispatched once for the whole batch.
+   */
+  void BackProjectBatch(const float* u, const float* v, const float* depth,
+                        int size, float* x, float* y, float* z) const;
+
   // Getters
   DistortionModel distortion_model() const { return model_; }
   const std::array<float, 5>& distortion_coeffs() const { return coeffs_; }
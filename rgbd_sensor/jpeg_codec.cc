@@ -0,0 +1,330 @@
+#include "rgbd_sensor/jpeg_codec.h"
+
+#include <csetjmp>
+#include <cstdio>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+namespace rs2_lcm {
+namespace {
+
+// The initial size of encoded images, when the output has no capacity yet.
+constexpr size_t kMinOutputSize = 64 * 1024;
+
+// libjpeg exits the process on errors by default. This jumps back to the
+// caller instead, which throws. The jump skips destructors, so the functions
+// calling setjmp() keep objects with destructors out of its scope, and C++
+// callbacks catch their exceptions and report them through libjpeg instead.
+struct ErrorManager {
+  jpeg_error_mgr pub;
+  jmp_buf jump;
+  char message[JMSG_LENGTH_MAX];
+};
+
+void ErrorExit(j_common_ptr info) {
+  auto* error = reinterpret_cast<ErrorManager*>(info->err);
+  (*info->err->format_message)(info, error->message);
+  longjmp(error->jump, 1);
+}
+
+// Warnings, e.g. about trailing garbage, are not worth a log line per frame.
+void OutputMessage(j_common_ptr) {}
+
+void InitErrorManager(ErrorManager* error) {
+  jpeg_std_error(&error->pub);
+  error->pub.error_exit = ErrorExit;
+  error->pub.output_message = OutputMessage;
+  error->message[0] = '\0';
+}
+
+// Writes the encoded image into a vector, growing it as needed.
+struct Destination {
+  jpeg_destination_mgr pub;
+  std::vector<uint8_t>* data;
+};
+
+// Resizes the output to @p size, and fails the compression if that throws.
+void ResizeOutput(j_compress_ptr info, size_t size) {
+  auto* dest = reinterpret_cast<Destination*>(info->dest);
+  bool resized = true;
+  try {
+    dest->data->resize(size);
+  } catch (...) {
+    resized = false;
+  }
+  // Outside of the catch block, which the jump must not leave.
+  if (!resized) ERREXIT1(info, JERR_OUT_OF_MEMORY, 0);
+}
+
+void InitDestination(j_compress_ptr info) {
+  auto* dest = reinterpret_cast<Destination*>(info->dest);
+  // Starts from the capacity the vector already has, which is usually enough
+  // for the whole image.
+  ResizeOutput(info, std::max(dest->data->capacity(), kMinOutputSize));
+  dest->pub.next_output_byte = dest->data->data();
+  dest->pub.free_in_buffer = dest->data->size();
+}
+
+boolean EmptyOutputBuffer(j_compress_ptr info) {
+  auto* dest = reinterpret_cast<Destination*>(info->dest);
+  // Called when the whole vector is full.
+  const size_t used = dest->data->size();
+  ResizeOutput(info, used * 2);
+  dest->pub.next_output_byte = dest->data->data() + used;
+  dest->pub.free_in_buffer = dest->data->size() - used;
+  return TRUE;
+}
+
+void TermDestination(j_compress_ptr info) {
+  auto* dest = reinterpret_cast<Destination*>(info->dest);
+  // Shrinking never allocates.
+  ResizeOutput(info, dest->data->size() - dest->pub.free_in_buffer);
+}
+
+// JPEG stores full range YCbCr, while YUYV from cameras is video range: Y in
+// [16, 235], Cb and Cr in [16, 240].
+struct RangeTables {
+  uint8_t luma[256];
+  uint8_t chroma[256];
+};
+
+const RangeTables& GetRangeTables() {
+  static const RangeTables tables = []() {
+    RangeTables result;
+    for (int i = 0; i < 256; i++) {
+      const int luma = ((i - 16) * 255 + 109) / 219;
+      const int chroma = 128 + ((i - 128) * 255 + (i < 128 ? -112 : 112)) / 224;
+      result.luma[i] = std::min(std::max(luma, 0), 255);
+      result.chroma[i] = std::min(std::max(chroma, 0), 255);
+    }
+    return result;
+  }();
+  return tables;
+}
+
+// Splits the @p width pixels of the YUYV row @p in into full range Y, Cb and
+// Cr rows. The rows are padded to @p padded_width luma samples by repeating
+// the last pixel pair.
+void DeinterleaveYuyvRow(const uint8_t* in, int width, int padded_width,
+                         JSAMPROW y, JSAMPROW cb, JSAMPROW cr) {
+  const RangeTables& tables = GetRangeTables();
+  for (int x = 0; x < padded_width; x += 2) {
+    const uint8_t* pair = in + std::min(x, width - 2) * 2;
+    y[x] = tables.luma[pair[0]];
+    y[x + 1] = tables.luma[pair[2]];
+    cb[x / 2] = tables.chroma[pair[1]];
+    cr[x / 2] = tables.chroma[pair[3]];
+  }
+}
+
+void CheckChannels(int channels) {
+  if (channels != 1 && channels != 3) {
+    throw std::runtime_error("JPEG images have 1 or 3 channels, not " +
+                             std::to_string(channels));
+  }
+}
+
+}  // namespace
+
+struct JpegEncoder::Impl {
+  ErrorManager error;
+  Destination dest;
+  jpeg_compress_struct info;
+  // The parameters the compressor is configured for, if any.
+  bool configured{false};
+  bool yuyv{false};
+  int width{0};
+  int height{0};
+  int channels{0};
+  int quality{0};
+  ChromaSubsampling subsampling{ChromaSubsampling::YUV420};
+  std::vector<JSAMPROW> rows;
+  // One MCU row of Y, Cb and Cr for EncodeYuyv().
+  std::vector<JSAMPLE> planes[3];
+  JSAMPROW plane_rows[3][DCTSIZE];
+};
+
+JpegEncoder::JpegEncoder() : impl_(new Impl) {
+  InitErrorManager(&impl_->error);
+  impl_->info.err = &impl_->error.pub;
+  jpeg_create_compress(&impl_->info);
+  impl_->dest.pub.init_destination = InitDestination;
+  impl_->dest.pub.empty_output_buffer = EmptyOutputBuffer;
+  impl_->dest.pub.term_destination = TermDestination;
+  impl_->info.dest = &impl_->dest.pub;
+}
+
+JpegEncoder::~JpegEncoder() { jpeg_destroy_compress(&impl_->info); }
+
+void JpegEncoder::Encode(const uint8_t* pixels, int width, int height,
+                         int channels, int quality,
+                         ChromaSubsampling subsampling,
+                         std::vector<uint8_t>* data) {
+  CheckChannels(channels);
+  Impl& impl = *impl_;
+  jpeg_compress_struct& info = impl.info;
+  // The parameters stay set across images, so that the tables are only
+  // rebuilt when they change.
+  const bool reconfigure =
+      !impl.configured || impl.yuyv || impl.width != width ||
+      impl.height != height || impl.channels != channels ||
+      impl.quality != quality || impl.subsampling != subsampling;
+  // Allocates before setjmp().
+  impl.rows.resize(height);
+  for (int row = 0; row < height; row++) {
+    impl.rows[row] = const_cast<JSAMPROW>(pixels + row * width * channels);
+  }
+  impl.dest.data = data;
+
+  if (setjmp(impl.error.jump)) {
+    jpeg_abort_compress(&info);
+    impl.configured = false;
+    throw std::runtime_error(std::string("JPEG compression failed: ") +
+                             impl.error.message);
+  }
+
+  if (reconfigure) {
+    info.image_width = width;
+    info.image_height = height;
+    info.input_components = channels;
+    info.in_color_space = channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    if (channels == 3) {
+      info.comp_info[0].h_samp_factor =
+          subsampling == ChromaSubsampling::YUV444 ? 1 : 2;
+      info.comp_info[0].v_samp_factor =
+          subsampling == ChromaSubsampling::YUV420 ? 2 : 1;
+    }
+    impl.configured = true;
+    impl.yuyv = false;
+    impl.width = width;
+    impl.height = height;
+    impl.channels = channels;
+    impl.quality = quality;
+    impl.subsampling = subsampling;
+  }
+
+  jpeg_start_compress(&info, TRUE);
+  while (info.next_scanline < info.image_height) {
+    jpeg_write_scanlines(&info, impl.rows.data() + info.next_scanline,
+                         info.image_height - info.next_scanline);
+  }
+  jpeg_finish_compress(&info);
+}
+
+void JpegEncoder::EncodeYuyv(const uint8_t* yuyv, int width, int height,
+                             int quality, std::vector<uint8_t>* data) {
+  if (width < 2 || width % 2 != 0) {
+    throw std::runtime_error("YUYV images must have an even width");
+  }
+  Impl& impl = *impl_;
+  jpeg_compress_struct& info = impl.info;
+  // Luma is fed in whole MCUs of 16 x 8 pixels, chroma at half the width.
+  const int luma_width = (width + 2 * DCTSIZE - 1) / (2 * DCTSIZE) * 2 *
+                         DCTSIZE;
+  const bool reconfigure = !impl.configured || !impl.yuyv ||
+                           impl.width != width || impl.height != height ||
+                           impl.quality != quality;
+  // Allocates before setjmp().
+  if (reconfigure) {
+    for (int c = 0; c < 3; c++) {
+      const int plane_width = c == 0 ? luma_width : luma_width / 2;
+      impl.planes[c].resize(plane_width * DCTSIZE);
+      for (int row = 0; row < DCTSIZE; row++) {
+        impl.plane_rows[c][row] = impl.planes[c].data() + row * plane_width;
+      }
+    }
+  }
+  impl.dest.data = data;
+
+  if (setjmp(impl.error.jump)) {
+    jpeg_abort_compress(&info);
+    impl.configured = false;
+    throw std::runtime_error(std::string("JPEG compression failed: ") +
+                             impl.error.message);
+  }
+
+  if (reconfigure) {
+    info.image_width = width;
+    info.image_height = height;
+    info.input_components = 3;
+    info.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    info.raw_data_in = TRUE;
+    info.comp_info[0].h_samp_factor = 2;
+    info.comp_info[0].v_samp_factor = 1;
+    for (int c = 1; c < 3; c++) {
+      info.comp_info[c].h_samp_factor = 1;
+      info.comp_info[c].v_samp_factor = 1;
+    }
+    impl.configured = true;
+    impl.yuyv = true;
+    impl.width = width;
+    impl.height = height;
+    impl.quality = quality;
+  }
+
+  JSAMPARRAY planes[3] = {impl.plane_rows[0], impl.plane_rows[1],
+                          impl.plane_rows[2]};
+  jpeg_start_compress(&info, TRUE);
+  for (int y = 0; y < height; y += DCTSIZE) {
+    // The last MCU row is padded by repeating the last image row.
+    for (int row = 0; row < DCTSIZE; row++) {
+      const int image_row = std::min(y + row, height - 1);
+      DeinterleaveYuyvRow(yuyv + image_row * width * 2, width, luma_width,
+                          planes[0][row], planes[1][row], planes[2][row]);
+    }
+    jpeg_write_raw_data(&info, planes, DCTSIZE);
+  }
+  jpeg_finish_compress(&info);
+}
+
+struct JpegDecoder::Impl {
+  ErrorManager error;
+  jpeg_decompress_struct info;
+};
+
+JpegDecoder::JpegDecoder() : impl_(new Impl) {
+  InitErrorManager(&impl_->error);
+  impl_->info.err = &impl_->error.pub;
+  jpeg_create_decompress(&impl_->info);
+}
+
+JpegDecoder::~JpegDecoder() { jpeg_destroy_decompress(&impl_->info); }
+
+void JpegDecoder::Decode(const uint8_t* data, size_t size, int width,
+                         int height, int channels, uint8_t* pixels) {
+  CheckChannels(channels);
+  Impl& impl = *impl_;
+  jpeg_decompress_struct& info = impl.info;
+  if (setjmp(impl.error.jump)) {
+    jpeg_abort_decompress(&info);
+    throw std::runtime_error(std::string("JPEG decompression failed: ") +
+                             impl.error.message);
+  }
+
+  jpeg_mem_src(&info, data, size);
+  jpeg_read_header(&info, TRUE);
+  info.out_color_space = channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+  jpeg_start_decompress(&info);
+  if (static_cast<int>(info.output_width) != width ||
+      static_cast<int>(info.output_height) != height ||
+      info.output_components != channels) {
+    jpeg_abort_decompress(&info);
+    throw std::runtime_error("Decoded image format mismatch");
+  }
+  while (info.output_scanline < info.output_height) {
+    JSAMPROW row = pixels + info.output_scanline * width * channels;
+    jpeg_read_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_decompress(&info);
+}
+
+}  // namespace rs2_lcm
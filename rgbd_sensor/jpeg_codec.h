@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace rs2_lcm {
+
+/// How JpegEncoder samples the chroma of color images.
+enum class ChromaSubsampling {
+  /// Full resolution chroma.
+  YUV444 = 0,
+  /// Chroma at half the horizontal resolution.
+  YUV422,
+  /// Chroma at half the horizontal and vertical resolution.
+  YUV420,
+};
+
+/**
+ * JPEG compression with libjpeg. The compressor is created once and reused
+ * for every image, and is only reconfigured when the format, quality or
+ * subsampling of the images changes. Not thread safe.
+ */
+class JpegEncoder {
+ public:
+  JpegEncoder();
+  ~JpegEncoder();
+
+  JpegEncoder(const JpegEncoder&) = delete;
+  JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+  /**
+   * Encodes the @p width x @p height pixels at @p pixels, which are gray
+   * for 1 @p channels or RGB for 3, into @p data, reusing its capacity.
+   * @p quality is in [0, 100]. @p subsampling is ignored for gray images.
+   * @throws std::runtime_error if the encoding fails.
+   */
+  void Encode(const uint8_t* pixels, int width, int height, int channels,
+              int quality, ChromaSubsampling subsampling,
+              std::vector<uint8_t>* data);
+
+  /**
+   * Encodes the @p width x @p height YUYV (BT.601 video range, see
+   * YuyvToRgb()) pixels at @p yuyv with 4:2:2 chroma, feeding the planes to
+   * libjpeg as they are instead of converting to RGB and back. The result
+   * decodes to the same colors as the RGB conversion. @p width must be even.
+   * @throws std::runtime_error if the encoding fails.
+   */
+  void EncodeYuyv(const uint8_t* yuyv, int width, int height, int quality,
+                  std::vector<uint8_t>* data);
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+/// JPEG decompression with libjpeg, reusing one decompressor. Not thread
+/// safe.
+class JpegDecoder {
+ public:
+  JpegDecoder();
+  ~JpegDecoder();
+
+  JpegDecoder(const JpegDecoder&) = delete;
+  JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+  /**
+   * Decodes the @p size bytes at @p data into the @p width x @p height
+   * pixels at @p pixels, as gray for 1 @p channels or RGB for 3.
+   * @throws std::runtime_error if @p data is not a JPEG image of that size.
+   */
+  void Decode(const uint8_t* data, size_t size, int width, int height,
+              int channels, uint8_t* pixels);
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace rs2_lcm
@@ -0,0 +1,47 @@
+#include "rgbd_sensor/lcm_point_cloud_publisher.h"
+
+#include <drake/common/text_logging.h>
+#include "rgbd_sensor/lcm_rgbd_common.h"
+
+namespace rs2_lcm {
+
+LcmPointCloudPublisher::LcmPointCloudPublisher(
+    const std::string& camera_name, const std::string& lcm_channel_name,
+    bool with_color, const RGBDSensor* sensor, lcm::LCM* lcm)
+    : camera_name_(camera_name),
+      lcm_channel_name_(lcm_channel_name),
+      sensor_(sensor),
+      generator_(sensor, with_color),
+      lcm_(lcm) {
+  drake::log()->info("Publishing point clouds on {}", lcm_channel_name_);
+}
+
+void LcmPointCloudPublisher::PublishPointCloud() {
+  const std::shared_ptr<const ImageFrameset> frameset =
+      sensor_->GetLatestFrameset();
+  // The cloud is computed straight into the message, which is reused.
+  uint64_t timestamp = 0;
+  int rows = 0;
+  int cols = 0;
+  if (!generator_.ComputeInto(*frameset, &timestamp, &message_.data, &rows,
+                              &cols)) {
+    return;
+  }
+
+  message_.utime = timestamp;
+  message_.seq = frameset->sequence;
+  message_.frame_name = ImageTypeToFrameName(ImageType::DEPTH);
+  message_.camera_name = camera_name_;
+  message_.organized = generator_.voxel_size() == 0;
+  message_.width = cols;
+  message_.height = rows;
+  message_.point_format = generator_.with_color()
+                              ? rs2_lcm::point_cloud_t::XYZRGB
+                              : rs2_lcm::point_cloud_t::XYZ;
+  message_.point_step = generator_.point_step();
+  message_.size = message_.data.size();
+
+  lcm_->publish<rs2_lcm::point_cloud_t>(lcm_channel_name_, &message_);
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+
+#include <lcm/lcm-cpp.hpp>
+#include "rgbd_sensor/point_cloud.h"
+#include "rgbd_sensor/rgbd_sensor.h"
+#include "rs2_lcm/point_cloud_t.hpp"
+
+namespace rs2_lcm {
+
+/// Class which computes point clouds from the depth images of a camera and
+/// publishes them over lcm. They are organized unless thinned, see
+/// set_voxel_size().
+class LcmPointCloudPublisher {
+ public:
+  /// @param camera_name The name of this camera (will be published in
+  /// point cloud messages).
+  ///
+  /// @param lcm_channel_name The name of the LCM channel to publish
+  /// point clouds on.
+  ///
+  /// @param with_color Publish XYZRGB rather than XYZ points.
+  ///
+  /// @param sensor Sensor to read images from.  This parameter is
+  /// aliased and must be valid for the lifetime of this object.
+  ///
+  /// @param lcm An LCM object to use to publish messages.  This
+  /// parameter is aliased and must be valid for the lifetime of this
+  /// object
+  LcmPointCloudPublisher(const std::string& camera_name,
+                         const std::string& lcm_channel_name, bool with_color,
+                         const RGBDSensor* sensor, lcm::LCM* lcm);
+
+  /// Publish the point cloud of the current depth image.
+  void PublishPointCloud();
+
+  /// Thins the published clouds with a voxel grid of @p voxel_size meters,
+  /// see PointCloudGenerator::set_voxel_size(), and publishes them as
+  /// unorganized.  0 disables it.
+  void set_voxel_size(float voxel_size) {
+    generator_.set_voxel_size(voxel_size);
+  }
+
+ private:
+  const std::string camera_name_;
+  const std::string lcm_channel_name_;
+  const RGBDSensor* sensor_;
+  PointCloudGenerator generator_;
+
+  lcm::LCM* lcm_{nullptr};
+  // Reused across messages, so that the point buffer is only allocated once.
+  rs2_lcm::point_cloud_t message_{};
+};
+
+}  // namespace rs2_lcm
@@ -1,5 +1,6 @@
 #include "rgbd_sensor/lcm_rgbd_common.h"
 
+#include "rgbd_sensor/image_codec.h"
 #include "rs2_lcm/image_description_t.hpp"
 
 namespace rs2_lcm {
@@ -220,4 +221,43 @@ extrinsics_t SerializeExtrinsics(ImageType from, ImageType to,
   return extrinsics;
 }
 
+RawImageData DecodeLcmImage(const drake::lcmt_image& image) {
+  int channels = 0;
+  switch (image.pixel_format) {
+    case drake::lcmt_image::PIXEL_FORMAT_RGB: {
+      channels = 3;
+      break;
+    }
+    case drake::lcmt_image::PIXEL_FORMAT_GRAY:
+    case drake::lcmt_image::PIXEL_FORMAT_DEPTH: {
+      channels = 1;
+      break;
+    }
+    default:
+      throw std::runtime_error("Unsupported pixel format: " +
+                               std::to_string(image.pixel_format));
+  }
+  int scalar_size = 0;
+  switch (image.channel_type) {
+    case drake::lcmt_image::CHANNEL_TYPE_UINT8: {
+      scalar_size = 1;
+      break;
+    }
+    case drake::lcmt_image::CHANNEL_TYPE_UINT16: {
+      scalar_size = 2;
+      break;
+    }
+    default:
+      throw std::runtime_error("Unsupported channel type: " +
+                               std::to_string(image.channel_type));
+  }
+
+  // Every byte is overwritten by the codec.
+  RawImageData decoded = RawImageData::MakeUninitialized(
+      image.height, image.width, channels, channels * scalar_size);
+  GetImageCodecForMethod(image.compression_method)
+      ->Decode(image.data.data(), image.data.size(), &decoded);
+  return decoded;
+}
+
 }  // namespace rs2_lcm
@@ -3,6 +3,7 @@
 #include <array>
 #include <string>
 
+#include <drake/lcmt_image.hpp>
 #include "rgbd_sensor/rgbd_sensor.h"
 #include "rs2_lcm/extrinsics_t.hpp"
 #include "rs2_lcm/intrinsics_t.hpp"
@@ -31,4 +32,11 @@ void DeserializeExtrinsics(const extrinsics_t& extrinsics,
 extrinsics_t SerializeExtrinsics(ImageType from, ImageType to,
                                  const Eigen::Isometry3f& isometry);
 
+/// Decodes the image in @p image with the registered codec of its
+/// compression_method (see GetImageCodecForMethod()).
+///
+/// @throws std::runtime_error if there is no such codec, the pixel format
+/// or channel type is not one that is published, or the data is invalid.
+RawImageData DecodeLcmImage(const drake::lcmt_image& image);
+
 }  // namespace rs2_lcm
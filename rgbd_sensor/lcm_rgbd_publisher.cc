@@ -2,13 +2,17 @@
 
 #include "sys/time.h"
 
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <drake/common/text_logging.h>
 #include <drake/lcmt_image.hpp>
 #include <drake/lcmt_image_array.hpp>
-#include <zlib.h>
+#include <tbb/task_group.h>
 #include "rgbd_sensor/lcm_rgbd_common.h"
 #include "rs2_lcm/camera_description_t.hpp"
 
@@ -25,24 +29,60 @@ LcmRgbdPublisher::LcmRgbdPublisher(
       lcm_channel_name_(lcm_channel_name),
       sensor_(sensor),
       lcm_(lcm) {
-  for (ImageType type : types_) {
-    image_seq_[type] = 0;
-  }
-
   drake::log()->info("Publishing descriptions on {} data on {}",
                      lcm_description_channel_name_, lcm_channel_name_);
+  set_compression_policy(CompressionPolicy());
 
-  bool depth_registration_requested =
-      std::find(types.begin(), types.end(),
-                ImageType::RECT_RGB_ALIGNED_DEPTH) != types.end();
-  bool hardware_registration_enabled =
-      sensor->is_enabled(ImageType::RECT_RGB_ALIGNED_DEPTH);
+  // Registered images the sensor does not produce itself are registered in
+  // software.
+  auto software_registration_requested = [&](ImageType type) {
+    return std::find(types.begin(), types.end(), type) != types.end() &&
+           !sensor->is_enabled(type);
+  };
   enabled_software_registration_ =
-      depth_registration_requested && !hardware_registration_enabled;
+      software_registration_requested(ImageType::RECT_RGB_ALIGNED_DEPTH);
+  enabled_software_color_registration_ =
+      software_registration_requested(ImageType::DEPTH_ALIGNED_RGB);
+
+  std::vector<ImageType> software_types;
+  if (enabled_software_registration_) {
+    software_types.push_back(ImageType::RECT_RGB_ALIGNED_DEPTH);
+  }
+  if (enabled_software_color_registration_) {
+    software_types.push_back(ImageType::DEPTH_ALIGNED_RGB);
+  }
+  if (!software_types.empty()) {
+    registration_stage_ =
+        std::make_unique<DepthRegistrationStage>(sensor, software_types);
+  }
 }
 
 LcmRgbdPublisher::~LcmRgbdPublisher() {}
 
+void LcmRgbdPublisher::set_compression_policy(
+    const CompressionPolicy& policy) {
+  for (int i = 0; i < kNumImageTypes; i++) {
+    StreamCodec& codec = codecs_[i];
+    codec.settings =
+        policy.Get(sensor_->camera_id(), static_cast<ImageType>(i));
+    codec.codec = GetImageCodec(codec.settings.codec);
+  }
+
+  // Checked up front, as the encoders would otherwise fail on every frame.
+  for (ImageType type : types_) {
+    const int channels = sensor_->get_image_channels(type);
+    const int scalar_size = sensor_->get_image_scalar_size(type);
+    const StreamCodec& codec = codecs_.at(static_cast<int>(type));
+    if (!codec.codec->Supports(channels, scalar_size)) {
+      throw std::runtime_error(
+          "Codec " + codec.settings.codec + " can not encode " +
+          ImageTypeToString(type) + " images of camera " +
+          sensor_->camera_id() + ", which have " + std::to_string(channels) +
+          " channels of " + std::to_string(scalar_size) + " bytes");
+    }
+  }
+}
+
 void LcmRgbdPublisher::PublishDescription() {
   rs2_lcm::camera_description_t desc{};
   desc.camera_name = camera_name_;
@@ -59,6 +99,10 @@ void LcmRgbdPublisher::PublishDescription() {
       sensor_query_type = sensor_->is_enabled(ImageType::RECT_RGB)
                               ? ImageType::RECT_RGB
                               : ImageType::RGB;
+    // Color registered to depth has the (possibly decimated) DEPTH geometry.
+    if (enabled_software_color_registration_ &&
+        type == ImageType::DEPTH_ALIGNED_RGB)
+      sensor_query_type = ImageType::DEPTH;
 
     image_desc.intrinsics = SerializeIntrinsics(
         sensor_->get_intrinsics(sensor_query_type));
@@ -87,59 +131,73 @@ void build_lcm_image_header(int32_t sequence, int64_t timestamp,
   image->header.frame_name = frame_name;
 }
 
-void build_lcm_image_message(const cv::Mat& image_mat, int expected_mat_type,
-                             bool bigendian, int8_t pixel_format,
-                             int8_t channel_type, int8_t compression_method,
-                             drake::lcmt_image* image) {
-  if (image_mat.type() != expected_mat_type) {
-    throw std::runtime_error("Unexpected image type in LcmRgbdPublisher");
-  }
-
-  image->height = image_mat.rows;
-  image->width = image_mat.cols;
-
-  // Drake uses FLOAT32 for depth messages, but since we're
-  // already in UINT16 just stay there.
-  image->row_stride = image_mat.elemSize() * image->width;
-  image->bigendian = bigendian;
-  image->pixel_format = pixel_format;
-  image->channel_type = channel_type;
-  image->compression_method = compression_method;
-  switch (compression_method) {
-    case drake::lcmt_image::COMPRESSION_METHOD_PNG: {
-      cv::imencode(".png", image_mat, image->data);
+// Fills in the format of @p image, which holds an image of @p type with
+// @p rows x @p cols pixels of @p channels scalars of @p scalar_size bytes,
+// encoded with @p codec.
+void build_lcm_image_format(ImageType type, int rows, int cols, int channels,
+                            int scalar_size,
+                            const LcmRgbdPublisher::StreamCodec& codec,
+                            drake::lcmt_image* image) {
+  image->height = rows;
+  image->width = cols;
+  image->row_stride = cols * channels * scalar_size;
+  image->bigendian = false;
+  switch (type) {
+    case ImageType::RGB:
+    case ImageType::RECT_RGB:
+    case ImageType::DEPTH_ALIGNED_RGB:
+      image->pixel_format = drake::lcmt_image::PIXEL_FORMAT_RGB;
       break;
-    }
-    case drake::lcmt_image::COMPRESSION_METHOD_JPEG: {
-      cv::imencode(".jpg", image_mat, image->data);
+    case ImageType::DEPTH:
+    case ImageType::RECT_RGB_ALIGNED_DEPTH:
+      // Drake uses FLOAT32 for depth messages, but since we're
+      // already in UINT16 just stay there.
+      // TODO(duy): It should be float but why float does
+      // not work with Linemod?
+      image->pixel_format = drake::lcmt_image::PIXEL_FORMAT_DEPTH;
       break;
-    }
-    case drake::lcmt_image::COMPRESSION_METHOD_ZLIB: {
-      const int source_size =
-          image->width * image->height * image_mat.elemSize();
-
-      // The destination buf_size must be slightly larger than the source
-      // size.
-      // http://refspecs.linuxbase.org/LSB_3.0.0/LSB-PDA/LSB-PDA/zlib-compress2-1.html
-      size_t buf_size = source_size * 1.001 + 12;
-      std::unique_ptr<uint8_t[]> buf(new uint8_t[buf_size]);
-
-      auto compress_status = compress2(
-          buf.get(), &buf_size,
-          reinterpret_cast<const Bytef*>(image_mat.ptr()),
-          source_size, Z_BEST_SPEED);
-      if (compress_status != Z_OK) {
-        throw std::runtime_error("zlib compression failed");
-      }
-
-      image->data.resize(buf_size);
-      memcpy(&image->data[0], buf.get(), buf_size);
+    case ImageType::IR:
+    case ImageType::IR_STEREO:
+      image->pixel_format = drake::lcmt_image::PIXEL_FORMAT_GRAY;
       break;
-    }
   }
+  image->channel_type = scalar_size == 1
+                            ? drake::lcmt_image::CHANNEL_TYPE_UINT8
+                            : drake::lcmt_image::CHANNEL_TYPE_UINT16;
+  image->compression_method = codec.codec->compression_method();
+}
+
+// Fills in @p image with @p img, an image of @p type, encoded as set by
+// @p codec.
+void build_lcm_image_message(ImageType type, const RawImageData& img,
+                             const LcmRgbdPublisher::StreamCodec& codec,
+                             drake::lcmt_image* image) {
+  build_lcm_image_format(type, img.rows(), img.cols(), img.channels(),
+                         img.scalar_size(), codec, image);
+  codec.codec->Encode(img, codec.settings, &image->data);
   image->size = image->data.size();
 }
 
+// Same as above for the RGB image of @p frameset, which is only converted
+// from YUYV if it was captured that way and @p codec can not encode YUYV.
+void build_lcm_color_message(const ImageFrameset& frameset,
+                             const LcmRgbdPublisher::StreamCodec& codec,
+                             drake::lcmt_image* image) {
+  if (frameset.yuyv_color) {
+    const RawImageData& yuyv = *frameset.yuyv_color->yuyv();
+    if (codec.codec->EncodeYuyv(yuyv, codec.settings, &image->data)) {
+      build_lcm_image_format(ImageType::RGB, yuyv.rows(), yuyv.cols(), 3, 1,
+                             codec, image);
+      image->size = image->data.size();
+      return;
+    }
+  }
+  uint64_t timestamp = 0;
+  build_lcm_image_message(ImageType::RGB,
+                          *frameset.image(ImageType::RGB, &timestamp), codec,
+                          image);
+}
+
 }  // namespace
 
 void LcmRgbdPublisher::PublishImages() {
@@ -147,108 +205,103 @@ void LcmRgbdPublisher::PublishImages() {
   gettimeofday(&tv, NULL);
   uint64_t utime = (tv.tv_sec * 1000000) + tv.tv_usec;
 
-  std::shared_ptr<const RawImageData> depth_image, color_image;
-  drake::lcmt_image_array images{};
-  images.header.seq = seq_++;
-  images.header.utime = utime;
-  uint64_t timestamp = 0;
-  cv::Mat depth_float;
+  // All images come from one snapshot, so they belong to the same capture
+  // cycle.
+  const std::shared_ptr<const ImageFrameset> frameset =
+      sensor_->GetLatestFrameset();
+
+  std::vector<ImageType> types;
   for (ImageType type : types_) {
-    if (!sensor_->is_enabled(type)) {
-      continue;
+    if (sensor_->is_enabled(type) && frameset->has_image(type)) {
+      types.push_back(type);
     }
+  }
 
-    auto img = sensor_->GetLatestImage(type, &timestamp);
-    if (!img) {
-      continue;
-    }
+  // Every image gets its own message up front, so that the encoders can fill
+  // them in concurrently. The registered images may not be produced, their
+  // messages are left out afterwards. The messages are reused across frames,
+  // so that the encoders write into buffers that are already allocated, and
+  // the vector never shrinks, as that would free them.
+  drake::lcmt_image_array& images = message_;
+  images.header.seq = seq_++;
+  images.header.utime = utime;
+  const size_t registered_index = types.size();
+  const size_t max_images = types.size() + (registration_stage_ ? 2 : 0);
+  if (images.images.size() < max_images) images.images.resize(max_images);
+  std::vector<uint8_t> encoded(max_images, false);
 
-    images.images.push_back(drake::lcmt_image());
-    drake::lcmt_image& image = images.images.back();
-
-    build_lcm_image_header(image_seq_.at(type), timestamp,
-                           ImageTypeToFrameName(type), &image);
-    switch (type) {
-      case ImageType::RGB:
-      case ImageType::RECT_RGB:
-      case ImageType::DEPTH_ALIGNED_RGB: {
-        cv::Mat rgb_mat = img->MakeCvImage(CV_8UC3);
-        cv::Mat bgr_mat;
-        cv::cvtColor(rgb_mat, bgr_mat, CV_RGB2BGR);
-        build_lcm_image_message(
-            bgr_mat, CV_8UC3, false, drake::lcmt_image::PIXEL_FORMAT_RGB,
-            drake::lcmt_image::CHANNEL_TYPE_UINT8,
-            drake::lcmt_image::COMPRESSION_METHOD_JPEG, &image);
-        color_image = img;
-        break;
+  // Encoders run on the process wide TBB scheduler, which every publisher
+  // shares, so the latency is that of the slowest encoder rather than the
+  // sum of them.
+  tbb::task_group encoders;
+  for (size_t i = 0; i < types.size(); i++) {
+    encoders.run([&, i]() {
+      const int index = static_cast<int>(types[i]);
+      drake::lcmt_image& image = images.images[i];
+      build_lcm_image_header(frameset->sequence,
+                             frameset->timestamps.at(index),
+                             ImageTypeToFrameName(types[i]), &image);
+      if (types[i] == ImageType::RGB) {
+        build_lcm_color_message(*frameset, codecs_.at(index), &image);
+      } else {
+        uint64_t timestamp = 0;
+        const auto& img = frameset->image(types[i], &timestamp);
+        build_lcm_image_message(types[i], *img, codecs_.at(index), &image);
       }
-      case ImageType::DEPTH: {
-        cv::Mat image_mat = img->MakeCvImage(CV_16UC1);
-        build_lcm_image_message(
-            image_mat, CV_16UC1, false,
-            drake::lcmt_image::PIXEL_FORMAT_DEPTH,
-            drake::lcmt_image::CHANNEL_TYPE_UINT16,
-            drake::lcmt_image::COMPRESSION_METHOD_ZLIB, &image);
-        if (enabled_software_registration_) {
-          depth_image = img;
-        }
-        break;
-      }
-      case ImageType::RECT_RGB_ALIGNED_DEPTH: {
-        cv::Mat image_mat = img->MakeCvImage(CV_16UC1);
+      encoded[i] = true;
+    });
+  }
+
+  // The stage started registering this frameset as soon as it arrived, so
+  // by now it has usually finished. The result is picked up on this thread
+  // while the other images are encoding, rather than in a task, so that no
+  // TBB worker blocks on it.
+  if (registration_stage_) {
+    const std::shared_ptr<const DepthRegistrationStage::Result> registered =
+        registration_stage_->GetResult(*frameset);
+    if (registered && registered->aligned_depth) {
+      encoders.run([&, registered]() {
+        drake::lcmt_image& image = images.images[registered_index];
+        build_lcm_image_header(
+            frameset->sequence, registered->depth_timestamp,
+            ImageTypeToFrameName(ImageType::RECT_RGB_ALIGNED_DEPTH), &image);
         build_lcm_image_message(
-            image_mat, CV_16UC1, false,
-            drake::lcmt_image::PIXEL_FORMAT_DEPTH,
-            // TODO(duy): It should be float but why float does
-            // not work with Linemod?
-            drake::lcmt_image::CHANNEL_TYPE_UINT16,
-            drake::lcmt_image::COMPRESSION_METHOD_ZLIB, &image);
-        break;
-      }
-      case ImageType::IR:
-      case ImageType::IR_STEREO: {
-        cv::Mat image_mat = img->MakeCvImage(CV_16UC1);
+            ImageType::RECT_RGB_ALIGNED_DEPTH, *registered->aligned_depth,
+            codecs_.at(static_cast<int>(ImageType::RECT_RGB_ALIGNED_DEPTH)),
+            &image);
+        encoded[registered_index] = true;
+      });
+    }
+    if (registered && registered->aligned_color) {
+      encoders.run([&, registered]() {
+        drake::lcmt_image& image = images.images[registered_index + 1];
+        // The color is resampled into the depth frame, so it is stamped
+        // with the depth image it was registered to.
+        build_lcm_image_header(
+            frameset->sequence, registered->depth_timestamp,
+            ImageTypeToFrameName(ImageType::DEPTH_ALIGNED_RGB), &image);
         build_lcm_image_message(
-            image_mat, CV_16UC1, false,
-            drake::lcmt_image::PIXEL_FORMAT_GRAY,
-            drake::lcmt_image::CHANNEL_TYPE_UINT16,
-            drake::lcmt_image::COMPRESSION_METHOD_PNG, &image);
-        break;
-      }
+            ImageType::DEPTH_ALIGNED_RGB, *registered->aligned_color,
+            codecs_.at(static_cast<int>(ImageType::DEPTH_ALIGNED_RGB)),
+            &image);
+        encoded[registered_index + 1] = true;
+      });
     }
   }
+  encoders.wait();
 
-  if (enabled_software_registration_) {
-    if (std::find(types_.begin(), types_.end(), ImageType::DEPTH) ==
-        types_.end()) {
-      depth_image = sensor_->GetLatestImage(ImageType::DEPTH, &timestamp);
-    }
-
-    if (depth_image && color_image) {
-      const auto color_intrinsics = sensor_->get_intrinsics(ImageType::RGB);
-      const auto depth_intrinsics = sensor_->get_intrinsics(ImageType::DEPTH);
-      const auto X_rgb_depth =
-          sensor_->get_extrinsics(ImageType::DEPTH, ImageType::RGB);
-      RawImageData depth_registered =
-          DoRegisterDepthToColor(color_intrinsics, depth_intrinsics,
-                                 X_rgb_depth, *color_image, *depth_image,
-                                 ImageType::DEPTH);
-      images.images.push_back(drake::lcmt_image());
-      drake::lcmt_image& image = images.images.back();
-      build_lcm_image_header(
-          image_seq_.at(ImageType::DEPTH), timestamp,
-          ImageTypeToFrameName(ImageType::RECT_RGB_ALIGNED_DEPTH), &image);
-      build_lcm_image_message(
-          depth_registered.MakeCvImage(CV_16UC1), CV_16UC1, false,
-          drake::lcmt_image::PIXEL_FORMAT_DEPTH,
-          // TODO(duy): It should be float but why float does
-          // not work with Linemod?
-          drake::lcmt_image::CHANNEL_TYPE_UINT16,
-          drake::lcmt_image::COMPRESSION_METHOD_PNG, &image);
+  // Only the first num_images messages are sent, the unused ones are moved
+  // past them.
+  size_t num_images = 0;
+  for (size_t i = 0; i < max_images; i++) {
+    if (!encoded[i]) continue;
+    if (num_images != i) {
+      std::swap(images.images[num_images], images.images[i]);
     }
+    num_images++;
   }
 
-  images.num_images = images.images.size();
+  images.num_images = num_images;
   lcm_->publish<drake::lcmt_image_array>(lcm_channel_name_, &images);
 }
 
@@ -1,10 +1,15 @@
 #pragma once
 
-#include <map>
+#include <array>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <drake/lcmt_image_array.hpp>
 #include <lcm/lcm-cpp.hpp>
+#include "rgbd_sensor/compression_policy.h"
+#include "rgbd_sensor/depth_registration_stage.h"
+#include "rgbd_sensor/image_codec.h"
 #include "rgbd_sensor/rgbd_sensor.h"
 
 namespace rs2_lcm {
@@ -37,6 +42,8 @@ class LcmRgbdPublisher {
                    const RGBDSensor* sensor,
                    lcm::LCM* lcm);
 
+  LcmRgbdPublisher(LcmRgbdPublisher&&) = default;
+
   ~LcmRgbdPublisher();
 
   /// Publish a description of this camera.
@@ -45,6 +52,19 @@ class LcmRgbdPublisher {
   /// Publish the current set of images.
   void PublishImages();
 
+  /// Sets how each image type is encoded, from the settings of this
+  /// camera in @p policy. Defaults to CompressionPolicy().
+  ///
+  /// @throws std::runtime_error if a codec is not registered, or can not
+  /// encode the images the sensor produces for its stream.
+  void set_compression_policy(const CompressionPolicy& policy);
+
+  /// The codec of one image type, resolved from a CompressionPolicy.
+  struct StreamCodec {
+    std::shared_ptr<const ImageCodec> codec;
+    CodecSettings settings;
+  };
+
  private:
   const std::vector<ImageType> types_;
   const std::string camera_name_;
@@ -52,10 +72,16 @@ class LcmRgbdPublisher {
   const std::string lcm_channel_name_;
   const RGBDSensor* sensor_;
   bool enabled_software_registration_;
+  bool enabled_software_color_registration_;
+  // Only set when either kind of software registration is enabled.
+  std::unique_ptr<DepthRegistrationStage> registration_stage_;
 
   lcm::LCM* lcm_{nullptr};
   int32_t seq_{0};
-  std::map <ImageType, int32_t> image_seq_;
+  std::array<StreamCodec, kNumImageTypes> codecs_;
+  // Reused across messages, so that the image buffers are only allocated
+  // once.
+  drake::lcmt_image_array message_{};
 };
 
 }  // namespace rs2_lcm
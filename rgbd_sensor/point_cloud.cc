@@ -0,0 +1,281 @@
+#include "rgbd_sensor/point_cloud.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace rs2_lcm {
+namespace {
+
+// Number of depth rows per task.
+constexpr int kGrainRows = 16;
+
+void CheckPointCloudInputs(const RayTable& depth_rays,
+                           const RawImageData& depth,
+                           const RawImageData& points, int channels) {
+  if (depth_rays.width() != depth.cols() ||
+      depth_rays.height() != depth.rows()) {
+    throw std::runtime_error("Depth image dimension mismatch");
+  }
+  if (depth.channels() != 1 || depth.scalar_size() != 2) {
+    throw std::runtime_error("Depth image format is incorrect");
+  }
+  if (points.cols() != depth.cols() || points.rows() != depth.rows() ||
+      points.channels() != channels || points.scalar_size() != sizeof(float)) {
+    throw std::runtime_error("Point cloud format is incorrect");
+  }
+}
+
+// Back projects the rows of @p depth in parallel, with @p color_fn(v, u, out)
+// filling in the channels past x, y, z of each point, if any.
+template <typename ColorFn>
+void BackProjectRows(const RayTable& depth_rays, const RawImageData& depth,
+                     RawImageData* points, ColorFn color_fn) {
+  const int cols = depth.cols();
+  const int channels = points->channels();
+  const float kNaN = std::numeric_limits<float>::quiet_NaN();
+  tbb::parallel_for(
+      tbb::blocked_range<int>(0, depth.rows(), kGrainRows),
+      [&](const tbb::blocked_range<int>& rows) {
+        for (int v = rows.begin(); v < rows.end(); v++) {
+          const uint16_t* depth_row =
+              reinterpret_cast<const uint16_t*>(depth.data()) + v * cols;
+          const float* ray_x = depth_rays.x_data() + v * cols;
+          const float* ray_y = depth_rays.y_data() + v * cols;
+          float* out = reinterpret_cast<float*>(points->data()) +
+                       v * cols * channels;
+          for (int u = 0; u < cols; u++, out += channels) {
+            if (depth_row[u] == 0) {
+              out[0] = out[1] = out[2] = kNaN;
+            } else {
+              const float z = depth_row[u] / 1000.f;
+              out[0] = ray_x[u] * z;
+              out[1] = ray_y[u] * z;
+              out[2] = z;
+            }
+            color_fn(v, u, out);
+          }
+        }
+      });
+}
+
+// Running sums of the points of one voxel.
+struct VoxelSum {
+  double x{0}, y{0}, z{0};
+  uint32_t r{0}, g{0}, b{0};
+  uint32_t count{0};
+};
+
+// Packs the voxel indices, each wrapped to 21 bits, into one key. Voxels
+// 2^21 apart collide, which is far beyond the range of the cameras.
+uint64_t VoxelKey(float x, float y, float z, float inv_voxel_size) {
+  constexpr uint64_t kMask = (1 << 21) - 1;
+  const auto index = [&](float c) {
+    return static_cast<uint64_t>(
+               static_cast<int64_t>(std::floor(c * inv_voxel_size))) &
+           kMask;
+  };
+  return index(x) | (index(y) << 21) | (index(z) << 42);
+}
+
+}  // namespace
+
+void ComputePointCloud(const RayTable& depth_rays, const RawImageData& depth,
+                       RawImageData* points) {
+  CheckPointCloudInputs(depth_rays, depth, *points, 3);
+  BackProjectRows(depth_rays, depth, points, [](int, int, float*) {});
+}
+
+void ComputeColoredPointCloud(const RayTable& depth_rays,
+                              const RawImageData& depth,
+                              const RawImageData& color,
+                              RawImageData* points) {
+  CheckPointCloudInputs(depth_rays, depth, *points, 4);
+  if (color.cols() != depth.cols() || color.rows() != depth.rows() ||
+      color.channels() != 3 || color.scalar_size() != 1) {
+    throw std::runtime_error("Color image format is incorrect");
+  }
+  const int cols = color.cols();
+  BackProjectRows(depth_rays, depth, points, [&](int v, int u, float* out) {
+    const uint8_t* rgb = color.data() + 3 * (u + v * cols);
+    const uint32_t packed = (static_cast<uint32_t>(rgb[0]) << 16) |
+                            (static_cast<uint32_t>(rgb[1]) << 8) | rgb[2];
+    memcpy(&out[3], &packed, sizeof(packed));
+  });
+}
+
+namespace {
+
+// Returns the voxels of @p points, see VoxelGridFilter().
+std::vector<VoxelSum> AccumulateVoxels(const RawImageData& points,
+                                       float voxel_size) {
+  if (!(voxel_size > 0)) {
+    throw std::runtime_error("Voxel size must be positive");
+  }
+  const int channels = points.channels();
+  if ((channels != 3 && channels != 4) ||
+      points.scalar_size() != sizeof(float)) {
+    throw std::runtime_error("Point cloud format is incorrect");
+  }
+
+  const float inv_voxel_size = 1.f / voxel_size;
+  const int num_points = points.rows() * points.cols();
+  const float* point = reinterpret_cast<const float*>(points.data());
+  std::unordered_map<uint64_t, int> voxel_indices;
+  std::vector<VoxelSum> voxels;
+  for (int i = 0; i < num_points; i++, point += channels) {
+    if (std::isnan(point[2])) continue;
+    const uint64_t key =
+        VoxelKey(point[0], point[1], point[2], inv_voxel_size);
+    auto inserted = voxel_indices.emplace(key, voxels.size());
+    if (inserted.second) voxels.emplace_back();
+    VoxelSum& voxel = voxels[inserted.first->second];
+    voxel.x += point[0];
+    voxel.y += point[1];
+    voxel.z += point[2];
+    voxel.count++;
+    if (channels == 4) {
+      uint32_t packed;
+      memcpy(&packed, &point[3], sizeof(packed));
+      voxel.r += (packed >> 16) & 0xff;
+      voxel.g += (packed >> 8) & 0xff;
+      voxel.b += packed & 0xff;
+    }
+  }
+  return voxels;
+}
+
+// Writes the centroid of each of @p voxels, as points of @p channels floats,
+// to @p out.
+void WriteVoxels(const std::vector<VoxelSum>& voxels, int channels,
+                 float* out) {
+  for (const VoxelSum& voxel : voxels) {
+    out[0] = voxel.x / voxel.count;
+    out[1] = voxel.y / voxel.count;
+    out[2] = voxel.z / voxel.count;
+    if (channels == 4) {
+      const uint32_t packed = (voxel.r / voxel.count) << 16 |
+                              (voxel.g / voxel.count) << 8 |
+                              voxel.b / voxel.count;
+      memcpy(&out[3], &packed, sizeof(packed));
+    }
+    out += channels;
+  }
+}
+
+}  // namespace
+
+RawImageData VoxelGridFilter(const RawImageData& points, float voxel_size) {
+  const std::vector<VoxelSum> voxels = AccumulateVoxels(points, voxel_size);
+  const int channels = points.channels();
+  RawImageData filtered = RawImageData::MakeUninitialized(
+      1, static_cast<int>(voxels.size()), channels, channels * sizeof(float));
+  WriteVoxels(voxels, channels, reinterpret_cast<float*>(filtered.data()));
+  return filtered;
+}
+
+int VoxelGridFilter(const RawImageData& points, float voxel_size,
+                    std::vector<uint8_t>* data) {
+  const std::vector<VoxelSum> voxels = AccumulateVoxels(points, voxel_size);
+  const int channels = points.channels();
+  data->resize(voxels.size() * channels * sizeof(float));
+  WriteVoxels(voxels, channels, reinterpret_cast<float*>(data->data()));
+  return static_cast<int>(voxels.size());
+}
+
+PointCloudGenerator::PointCloudGenerator(const RGBDSensor* sensor,
+                                         bool with_color)
+    : sensor_(sensor), with_color_(with_color) {}
+
+void PointCloudGenerator::set_voxel_size(float voxel_size) {
+  if (voxel_size < 0) {
+    throw std::runtime_error("Voxel size can not be negative");
+  }
+  voxel_size_ = voxel_size;
+}
+
+bool PointCloudGenerator::GetInputs(
+    const ImageFrameset& frameset, uint64_t* timestamp,
+    std::shared_ptr<const RawImageData>* depth,
+    std::shared_ptr<const RawImageData>* color) const {
+  *depth = frameset.image(ImageType::DEPTH, timestamp);
+  if (!*depth) return false;
+  if (with_color_) {
+    // Memoized by the sensor, so it is shared with other consumers of the
+    // depth aligned color.
+    *color = sensor_->GetDerivedImage(ImageType::DEPTH_ALIGNED_RGB, frameset);
+    if (!*color) return false;
+  }
+  return true;
+}
+
+std::shared_ptr<RawImageData> PointCloudGenerator::MakePooledPoints(
+    const RawImageData& depth) {
+  const size_t size = static_cast<size_t>(depth.rows()) * depth.cols() *
+                      point_step();
+  // Resolution changes replace the pool.
+  if (!pool_ || pool_->buffer_size() != size) {
+    pool_ = ImageBufferPool::Make(size);
+  }
+  return pool_->MakeImage(depth.rows(), depth.cols(),
+                          point_step() / sizeof(float), point_step());
+}
+
+void PointCloudGenerator::ComputeOrganized(const RawImageData& depth,
+                                           const RawImageData* color,
+                                           RawImageData* points) const {
+  const std::shared_ptr<const RayTable> depth_rays =
+      sensor_->get_ray_table(ImageType::DEPTH);
+  if (with_color_) {
+    ComputeColoredPointCloud(*depth_rays, depth, *color, points);
+  } else {
+    ComputePointCloud(*depth_rays, depth, points);
+  }
+}
+
+std::shared_ptr<const RawImageData> PointCloudGenerator::Compute(
+    const ImageFrameset& frameset, uint64_t* timestamp) {
+  std::shared_ptr<const RawImageData> depth, color;
+  if (!GetInputs(frameset, timestamp, &depth, &color)) return nullptr;
+  std::shared_ptr<RawImageData> points = MakePooledPoints(*depth);
+  ComputeOrganized(*depth, color.get(), points.get());
+  if (voxel_size_ > 0) {
+    return std::make_shared<const RawImageData>(
+        VoxelGridFilter(*points, voxel_size_));
+  }
+  return points;
+}
+
+bool PointCloudGenerator::ComputeInto(const ImageFrameset& frameset,
+                                      uint64_t* timestamp,
+                                      std::vector<uint8_t>* data, int* rows,
+                                      int* cols) {
+  std::shared_ptr<const RawImageData> depth, color;
+  if (!GetInputs(frameset, timestamp, &depth, &color)) return false;
+  if (voxel_size_ > 0) {
+    // The organized cloud is only an intermediate, so it stays pooled.
+    const std::shared_ptr<RawImageData> points = MakePooledPoints(*depth);
+    ComputeOrganized(*depth, color.get(), points.get());
+    *rows = 1;
+    *cols = VoxelGridFilter(*points, voxel_size_, data);
+    return true;
+  }
+
+  data->resize(static_cast<size_t>(depth->rows()) * depth->cols() *
+               point_step());
+  RawImageData points(depth->rows(), depth->cols(),
+                      point_step() / sizeof(float), point_step(), nullptr,
+                      data->data());
+  ComputeOrganized(*depth, color.get(), &points);
+  *rows = depth->rows();
+  *cols = depth->cols();
+  return true;
+}
+
+}  // namespace rs2_lcm
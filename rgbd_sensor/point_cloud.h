@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "rgbd_sensor/image.h"
+#include "rgbd_sensor/image_buffer_pool.h"
+#include "rgbd_sensor/ray_table.h"
+#include "rgbd_sensor/rgbd_sensor.h"
+
+namespace rs2_lcm {
+
+/**
+ * Back projects every pixel of @p depth (in mm) with @p depth_rays into
+ * @p points, an image of the same size with 3 float channels (x, y, z in
+ * meters). Pixels without depth become NaN. Rows are processed in parallel.
+ * @throws std::runtime_error if the images do not match @p depth_rays.
+ */
+void ComputePointCloud(const RayTable& depth_rays, const RawImageData& depth,
+                       RawImageData* points);
+
+/**
+ * Same as ComputePointCloud(), but @p points has 4 float channels, the 4th
+ * holding the matching pixel of @p color (a depth aligned RGB image, see
+ * DoRegisterColorToDepth()) packed like PCL's rgb field, i.e. the bits of the
+ * uint32 (r << 16 | g << 8 | b).
+ */
+void ComputeColoredPointCloud(const RayTable& depth_rays,
+                              const RawImageData& depth,
+                              const RawImageData& color, RawImageData* points);
+
+/**
+ * Returns @p points (as made by ComputePointCloud() or
+ * ComputeColoredPointCloud()) with all the points in each cube of
+ * @p voxel_size meters replaced by their centroid, and colors by their mean.
+ * The result is an unorganized cloud, a single row of the same format, in
+ * the order the voxels were first hit. NaN points are dropped.
+ * @throws std::runtime_error if @p voxel_size is not positive.
+ */
+RawImageData VoxelGridFilter(const RawImageData& points, float voxel_size);
+
+/**
+ * Same as above, but writes the filtered points into @p data, reusing its
+ * capacity, and returns their number.
+ */
+int VoxelGridFilter(const RawImageData& points, float voxel_size,
+                    std::vector<uint8_t>* data);
+
+/**
+ * Makes organized point clouds (see ComputePointCloud()) from the depth
+ * images of a sensor, in buffers recycled from a pool.
+ */
+class PointCloudGenerator {
+ public:
+  /**
+   * @param sensor Sensor providing the calibration, and the depth aligned
+   * color for colored clouds. This parameter is aliased and must be valid for
+   * the lifetime of this object.
+   * @param with_color Produce XYZRGB rather than XYZ points.
+   */
+  PointCloudGenerator(const RGBDSensor* sensor, bool with_color);
+
+  /**
+   * Returns the point cloud of the depth image of @p frameset, or nullptr if
+   * there is no depth image (or, for colored clouds, no color image).
+   * @param timestamp Set to the timestamp of the depth image.
+   */
+  std::shared_ptr<const RawImageData> Compute(const ImageFrameset& frameset,
+                                              uint64_t* timestamp);
+
+  /**
+   * Same as Compute(), but writes the points into @p data, reusing its
+   * capacity, rather than into a pooled buffer, so that they can be sent
+   * without another copy. Sets @p rows and @p cols to the dimensions of the
+   * cloud. Returns false if there is no cloud.
+   */
+  bool ComputeInto(const ImageFrameset& frameset, uint64_t* timestamp,
+                   std::vector<uint8_t>* data, int* rows, int* cols);
+
+  bool with_color() const { return with_color_; }
+
+  /// Bytes per point: x, y, z and, for colored clouds, the packed color.
+  int point_step() const { return (with_color_ ? 4 : 3) * sizeof(float); }
+
+  /**
+   * Sets the voxel size for VoxelGridFilter(), in meters, which makes the
+   * clouds unorganized. 0 (the default) disables the filter.
+   */
+  void set_voxel_size(float voxel_size);
+  float voxel_size() const { return voxel_size_; }
+
+ private:
+  // Sets @p depth and @p color to the images of @p frameset the cloud is
+  // computed from. Returns false if any is missing.
+  bool GetInputs(const ImageFrameset& frameset, uint64_t* timestamp,
+                 std::shared_ptr<const RawImageData>* depth,
+                 std::shared_ptr<const RawImageData>* color) const;
+
+  // Returns an uninitialized organized cloud for @p depth from pool_.
+  std::shared_ptr<RawImageData> MakePooledPoints(const RawImageData& depth);
+
+  // Computes the organized cloud of @p depth (and @p color) into @p points.
+  void ComputeOrganized(const RawImageData& depth, const RawImageData* color,
+                        RawImageData* points) const;
+
+  const RGBDSensor* sensor_{nullptr};
+  const bool with_color_{false};
+  float voxel_size_{0};
+  std::shared_ptr<ImageBufferPool> pool_;
+};
+
+}  // namespace rs2_lcm
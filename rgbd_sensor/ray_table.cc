@@ -0,0 +1,23 @@
+#include "rgbd_sensor/ray_table.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace rs2_lcm {
+
+RayTable::RayTable(const Intrinsics& intrinsics)
+    : intrinsics_(intrinsics),
+      x_(intrinsics.width() * intrinsics.height()),
+      y_(intrinsics.width() * intrinsics.height()) {
+  std::vector<float> us(width());
+  for (int u = 0; u < width(); u++) us[u] = u;
+  std::vector<float> vs(width());
+  for (int v = 0; v < height(); v++) {
+    std::fill(vs.begin(), vs.end(), v);
+    intrinsics_.BackProjectBatch(us.data(), vs.data(), nullptr, width(),
+                                 x_.data() + v * width(),
+                                 y_.data() + v * width(), nullptr);
+  }
+}
+
+}  // namespace rs2_lcm
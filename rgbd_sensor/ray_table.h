@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+#include "rgbd_sensor/intrinsics.h"
+
+namespace rs2_lcm {
+
+/**
+ * Precomputed back projection rays for every pixel of an image. For pixel
+ * (u, v), x(u, v) and y(u, v) are the undistorted normalized image
+ * coordinates, so that the 3D point with depth z is (z * x, z * y, z), the
+ * same as Intrinsics::BackProject() returns. Immutable once built, and meant
+ * to be shared by everything that back projects images with the same
+ * intrinsics.
+ */
+class RayTable {
+ public:
+  /**
+   * Builds the table for all width() x height() pixels of @p intrinsics.
+   * @throws if @p intrinsics can not be back projected.
+   */
+  explicit RayTable(const Intrinsics& intrinsics);
+
+  const Intrinsics& intrinsics() const { return intrinsics_; }
+  int width() const { return intrinsics_.width(); }
+  int height() const { return intrinsics_.height(); }
+
+  float x(int u, int v) const { return x_[u + v * width()]; }
+  float y(int u, int v) const { return y_[u + v * width()]; }
+
+  /**
+   * Row major arrays of x and y for all pixels.
+   */
+  const float* x_data() const { return x_.data(); }
+  const float* y_data() const { return y_.data(); }
+
+  /**
+   * Same as intrinsics().BackProject(Eigen::Vector2f(u, v), depth).
+   */
+  Eigen::Vector3f BackProject(int u, int v, float depth) const {
+    return Eigen::Vector3f(depth * x(u, v), depth * y(u, v), depth);
+  }
+
+ private:
+  const Intrinsics intrinsics_;
+  std::vector<float> x_;
+  std::vector<float> y_;
+};
+
+}  // namespace rs2_lcm
@@ -1,12 +1,16 @@
 #include "rgbd_sensor/real_sense_d400.h"
 
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <set>
 
 #include <boost/make_shared.hpp>
 #include <drake/common/scoped_singleton.h>
 #include <librealsense2/rs_advanced_mode.hpp>
 #include <librealsense2/rsutil.h>
+#include "rgbd_sensor/image_conversions.h"
 #include "rgbd_sensor/real_sense_common.h"
 
 #include "drake/common/text_logging.h"
@@ -60,32 +64,83 @@ Intrinsics MakeIntrinsics(const rs2_intrinsics& rs_intrin) {
                     rs_intrin.fy, rs_intrin.ppx, rs_intrin.ppy, model, coeffs);
 }
 
-std::shared_ptr<RawImageData> MakeImg(const void* src, int width, int height,
-                                      rs2_format pixel_type) {
+// Returns the number of channels and the number of bytes per channel for
+// @p pixel_type.
+void GetPixelLayout(rs2_format pixel_type, int* channels, int* scalar_size) {
   switch (pixel_type) {
     case RS2_FORMAT_Z16:
     case RS2_FORMAT_DISPARITY16:
     case RS2_FORMAT_Y16:
     case RS2_FORMAT_RAW16:
-      return RawImageData::MakeSharedRawImageData<uint16_t>(
-          height, width, 1, src);
+      *channels = 1;
+      *scalar_size = sizeof(uint16_t);
+      return;
     case RS2_FORMAT_Y8:
     case RS2_FORMAT_RAW8:
-      return RawImageData::MakeSharedRawImageData<uint8_t>(
-          height, width, 1, src);
+      *channels = 1;
+      *scalar_size = sizeof(uint8_t);
+      return;
     case RS2_FORMAT_RGB8:
     case RS2_FORMAT_BGR8:
-      return RawImageData::MakeSharedRawImageData<uint8_t>(
-          height, width, 3, src);
+      *channels = 3;
+      *scalar_size = sizeof(uint8_t);
+      return;
+    case RS2_FORMAT_YUYV:
+      // Y0 U Y1 V pixel pairs, see YuyvColorImage.
+      *channels = 2;
+      *scalar_size = sizeof(uint8_t);
+      return;
     case RS2_FORMAT_RGBA8:
     case RS2_FORMAT_BGRA8:
-      return RawImageData::MakeSharedRawImageData<uint8_t>(
-          height, width, 4, src);
+      *channels = 4;
+      *scalar_size = sizeof(uint8_t);
+      return;
     default:
       throw std::runtime_error("Doesn't support this type");
   }
 }
 
+// Makes a deep copy of @p frame.
+std::shared_ptr<RawImageData> MakeImg(const rs2::video_frame& frame,
+                                      rs2_format pixel_type) {
+  int channels, scalar_size;
+  GetPixelLayout(pixel_type, &channels, &scalar_size);
+  return std::make_shared<RawImageData>(frame.get_height(), frame.get_width(),
+                                        channels, channels * scalar_size,
+                                        frame.get_data());
+}
+
+// Makes an image that aliases @p frame's buffer. The rs2::frame is kept alive
+// (and out of librealsense's frame pool) until the last reference to the
+// returned image is dropped. Falls back to a deep copy if the rows are padded.
+std::shared_ptr<const RawImageData> WrapImg(const rs2::video_frame& frame,
+                                            rs2_format pixel_type) {
+  int channels, scalar_size;
+  GetPixelLayout(pixel_type, &channels, &scalar_size);
+  const int element_size = channels * scalar_size;
+  if (frame.get_stride_in_bytes() != frame.get_width() * element_size) {
+    return MakeImg(frame, pixel_type);
+  }
+  return std::make_shared<RawImageData>(
+      frame.get_height(), frame.get_width(), channels, element_size,
+      std::make_shared<const rs2::frame>(frame), frame.get_data());
+}
+
+// Copies @p frame's rows into @p image, which must have the same dimensions.
+void CopyImg(const rs2::video_frame& frame, RawImageData* image) {
+  const int row_size = image->cols() * image->channels() * image->scalar_size();
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(frame.get_data());
+  for (int y = 0; y < image->rows(); y++) {
+    memcpy(image->data() + y * row_size, src + y * frame.get_stride_in_bytes(),
+           row_size);
+  }
+}
+
+// Shared frames stay out of librealsense's frame pool until released, and the
+// pool only holds a handful of frames per stream (RS2_OPTION_FRAMES_QUEUE_SIZE
+// defaults to 16). Past this history depth, frames are copied instead.
+constexpr int kMaxSharedFrames = 8;
+
 std::shared_ptr<rs2::context> GetRealSense2Context() {
   return drake::GetScopedSingleton<rs2::context>();
 }
@@ -95,7 +150,7 @@ std::shared_ptr<rs2::context> GetRealSense2Context() {
 RealSenseD400::RealSenseD400(int camera_id, bool use_high_res,
                              const std::string& json_config_file)
     : RGBDSensor({ImageType::RGB, ImageType::DEPTH, ImageType::IR,
-                  ImageType::IR_STEREO}),
+                  ImageType::IR_STEREO, ImageType::RECT_RGB_ALIGNED_DEPTH}),
       context_(GetRealSense2Context()),
       pipeline_(*context_),
       camera_(context_->query_devices()[camera_id]),
@@ -141,18 +196,30 @@ RealSenseD400::RealSenseD400(int camera_id, bool use_high_res,
         profile.as<rs2::video_stream_profile>().get_intrinsics();
   }
 
-  for (const auto& type : supported_types) {
+  for (const auto& pair : supported_streams_) {
+    const ImageType type = pair.first;
     // Read camera's onboard intrinsics.
     set_intrinsics(type, MakeIntrinsics(rs_intrinsics.at(type)));
 
     // Read camera's onboard extrinsics.
-    for (const auto& to_type : supported_types) {
-      const auto rs_extrinsics = supported_streams_.at(type).get_extrinsics_to(
-          supported_streams_.at(to_type));
-      set_extrinsics(type, to_type,
+    for (const auto& to_pair : supported_streams_) {
+      const auto rs_extrinsics =
+          pair.second.get_extrinsics_to(to_pair.second);
+      set_extrinsics(type, to_pair.first,
                      real_sense::rs_extrinsics_to_eigen(rs_extrinsics));
     }
   }
+
+  // Aligned depth is resampled into the color camera.
+  set_intrinsics(ImageType::RECT_RGB_ALIGNED_DEPTH,
+                 get_intrinsics(ImageType::RGB));
+  for (const auto& pair : supported_streams_) {
+    set_extrinsics(ImageType::RECT_RGB_ALIGNED_DEPTH, pair.first,
+                   get_extrinsics(ImageType::RGB, pair.first));
+  }
+  set_extrinsics(ImageType::RECT_RGB_ALIGNED_DEPTH,
+                 ImageType::RECT_RGB_ALIGNED_DEPTH,
+                 Eigen::Isometry3f::Identity());
 }
 
 void RealSenseD400::LoadJsonConfig(const std::string& json_path) {
@@ -200,8 +267,8 @@ rs2::config RealSenseD400::MakeRealSenseConfig(
   }
 
   // Always enable rgb and depth.
-  config.enable_stream(RS2_STREAM_COLOR, -1, width, height, RS2_FORMAT_RGB8,
-                       30);
+  config.enable_stream(RS2_STREAM_COLOR, -1, width, height,
+                       yuyv_color_ ? RS2_FORMAT_YUYV : RS2_FORMAT_RGB8, 30);
   config.enable_stream(RS2_STREAM_DEPTH, -1, width, height, RS2_FORMAT_ANY, 30);
   if (std::find(desired_types.begin(), desired_types.end(), ImageType::IR) !=
       desired_types.end()) {
@@ -245,20 +312,30 @@ void RealSenseD400::DoStart(const std::vector<ImageType>& types) {
   pipeline_.start(config);
 
   thread_ = std::thread(&RealSenseD400::PollingThread, this);
+  if (is_enabled(ImageType::RECT_RGB_ALIGNED_DEPTH)) {
+    align_thread_ = std::thread(&RealSenseD400::AlignThread, this);
+  }
 }
 
 void RealSenseD400::DoStop() {
   run_ = false;
   thread_.join();
+  if (align_thread_.joinable()) align_thread_.join();
   pipeline_.stop();
 }
 
 void RealSenseD400::PollingThread() {
   std::map<const ImageType, TimeStampedImage> images;
   std::vector<ImageType> enabled_types = get_enabled_image_types();
+  // Color and depth are always streamed, aligned depth is computed from them.
+  std::set<ImageType> streamed_types = {ImageType::RGB, ImageType::DEPTH};
   for (const auto& type : enabled_types) {
-    images[type] = TimeStampedImage();
+    if (type != ImageType::RECT_RGB_ALIGNED_DEPTH) {
+      images[type] = TimeStampedImage();
+      streamed_types.insert(type);
+    }
   }
+  const bool align = is_enabled(ImageType::RECT_RGB_ALIGNED_DEPTH);
 
   rs2::frameset frameset;
   std::map<ImageType, rs2::frame> frames;
@@ -274,61 +351,106 @@ void RealSenseD400::PollingThread() {
     // Block until all frames have arrived.
     frameset = pipeline_.wait_for_frames();
 
-    if (frameset.size() != enabled_types.size()) continue;
+    if (frameset.size() != streamed_types.size()) continue;
+
+    // The filters only touch the depth frame of the frameset.
+    if (post_process_) {
+      frameset = frameset.apply_filter(depth_to_disparity)
+                     .apply_filter(spatial_filter)
+                     .apply_filter(low_pass_filter)
+                     .apply_filter(disparity_to_depth)
+                     .as<rs2::frameset>();
+    }
+
+    if (align) {
+      // The align thread publishes everything, so that the aligned depth
+      // lands in the same frameset as the images it was computed from.
+      align_queue_.enqueue(frameset);
+      continue;
+    }
 
     for (const auto& frame : frameset) {
       frames[StreamProfileToImageType(frame.get_profile())] = frame;
     }
+    UpdateImagesFromFrames(frames, &images);
+  }
+}
 
-    // Raw color and depth img.
-    rs2::frame& depth_frame = frames.at(ImageType::DEPTH);
-    if (post_process_) {
-      depth_frame = depth_to_disparity.process(depth_frame);
-      depth_frame = spatial_filter.process(depth_frame);
-      depth_frame = low_pass_filter.process(depth_frame);
-      depth_frame = disparity_to_depth.process(depth_frame);
+void RealSenseD400::AlignThread() {
+  std::map<const ImageType, TimeStampedImage> images;
+  for (const auto& type : get_enabled_image_types()) {
+    images[type] = TimeStampedImage();
+  }
+
+  rs2::align align_to_color(RS2_STREAM_COLOR);
+  std::map<ImageType, rs2::frame> frames;
+  rs2::frame frame;
+  while (run_) {
+    // Wakes up periodically to check run_.
+    if (!align_queue_.try_wait_for_frame(&frame, 100)) continue;
+
+    const rs2::frameset frameset = frame.as<rs2::frameset>();
+    for (const auto& stream_frame : frameset) {
+      frames[StreamProfileToImageType(stream_frame.get_profile())] =
+          stream_frame;
     }
+    frames[ImageType::RECT_RGB_ALIGNED_DEPTH] =
+        align_to_color.process(frameset).get_depth_frame();
+    UpdateImagesFromFrames(frames, &images);
+  }
+}
 
-    // Make images.
-    for (auto& pair : images) {
-      const ImageType type = pair.first;
-      const rs2::video_frame frame = frames.at(type).as<rs2::video_frame>();
-      pair.second.timestamp = (uint64_t)frame.get_timestamp();
-      std::shared_ptr<RawImageData> img;
-      if (!is_infrared_image(type)) {
-        img = MakeImg(frame.get_data(), frame.get_width(), frame.get_height(),
-                  supported_streams_.at(type).format());
-      } else {
-        // d400 returns images in 8 bits. but rgbd sensor wants 16 bits.
-        img = RawImageData::MakeSharedRawImageData<uint16_t>(
-            frame.get_height(), frame.get_width(), 1);
-        auto addr = reinterpret_cast<const uint8_t*>(frame.get_data());
-        auto img_view = img->mutable_slice<uint16_t>();
-        for (int x = 0; x < frame.get_width(); x++) {
-          for (int y = 0; y < frame.get_height(); y++) {
-            img_view(y, x) = addr[x + y * frame.get_width()] * 256;
-          }
-        }
-      }
-      // Scale depth image to units of mm.
-      // This could cause on overflow if distance is > 65 ish meters.
-      if (is_depth_image(pair.first)) {
-        auto depth_view = img->mutable_slice<uint16_t>();
-        // Note: Can't do depth_view *= scale, where scale < 0. I think eigen
-        // casts scale to uint16_t first.
-        for (int x = 0; x < depth_view.cols(); x++) {
-          for (int y = 0; y < depth_view.rows(); y++) {
-            depth_view(y, x) =
-                static_cast<uint16_t>(depth_view(y, x) * depth_scale_ * 1e3);
-          }
-        }
-      }
-
-      pair.second.data = img;
+void RealSenseD400::UpdateImagesFromFrames(
+    const std::map<ImageType, rs2::frame>& frames,
+    std::map<const ImageType, TimeStampedImage>* images) {
+  // The depth units are commonly 1mm already, in which case the depth frames
+  // need no rescaling and can be shared without copying.
+  const bool depth_in_mm = std::abs(depth_scale_ * 1e3 - 1.0) < 1e-6;
+  const bool share_frames = get_history_depth() <= kMaxSharedFrames;
+
+  // Make images.
+  for (auto& pair : *images) {
+    const ImageType type = pair.first;
+    const rs2::video_frame frame = frames.at(type).as<rs2::video_frame>();
+    const rs2_format format = frame.get_profile().format();
+    pair.second.timestamp = (uint64_t)frame.get_timestamp();
+    std::shared_ptr<const RawImageData> img;
+    if (is_infrared_image(type) && ir_16bit_ && format == RS2_FORMAT_Y8) {
+      // The legacy 16 bit representation, see set_ir_16bit().
+      auto ir = MakePooledImage(type, frame.get_height(), frame.get_width(), 1,
+                                sizeof(uint16_t));
+      WidenY8ToY16(reinterpret_cast<const uint8_t*>(frame.get_data()),
+                   frame.get_stride_in_bytes(), frame.get_width(),
+                   frame.get_height(),
+                   reinterpret_cast<uint16_t*>(ir->data()));
+      img = ir;
+    } else if (is_depth_image(type) && !depth_in_mm) {
+      // Scale depth image to units of mm while copying it out. Distances
+      // beyond ~65 meters saturate.
+      auto depth = MakePooledImage(type, frame.get_height(), frame.get_width(),
+                                   1, sizeof(uint16_t));
+      ScaleDepth(reinterpret_cast<const uint16_t*>(frame.get_data()),
+                 frame.get_stride_in_bytes(), frame.get_width(),
+                 frame.get_height(), static_cast<float>(depth_scale_ * 1e3),
+                 reinterpret_cast<uint16_t*>(depth->data()));
+      img = depth;
+    } else if (share_frames) {
+      // Color, IR, and depth that is already in mm, are handed out without
+      // copying.
+      img = WrapImg(frame, format);
+    } else {
+      int channels, scalar_size;
+      GetPixelLayout(format, &channels, &scalar_size);
+      auto copy = MakePooledImage(type, frame.get_height(), frame.get_width(),
+                                  channels, channels * scalar_size);
+      CopyImg(frame, copy.get());
+      img = copy;
     }
 
-    UpdateImages(images);
+    pair.second.data = img;
   }
+
+  UpdateImages(*images);
 }
 
 }  // namespace rs2_lcm
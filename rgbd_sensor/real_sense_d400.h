@@ -17,6 +17,11 @@ namespace rs2_lcm {
 /**
  * Only tested to work with D455, D435 and D415 for now.
  *
+ * ImageType::RECT_RGB_ALIGNED_DEPTH is produced by librealsense's rs2::align
+ * on a separate worker thread, so that alignment of one frameset overlaps
+ * with capturing and post processing the next one. It has the color
+ * intrinsics, and the same extrinsics as ImageType::RGB.
+ *
  * Notes:
  * The depth images and point cloud is set to be post processed by default.
  * Camera settings are saved in json files in /cfg. These config files are
@@ -56,6 +61,30 @@ class RealSenseD400 : public RGBDSensor {
     post_process_ = flag;
   }
 
+  /**
+   * Captures color as YUYV instead of RGB8, which librealsense would convert
+   * from YUYV on the host. The images are published as
+   * ImageFrameset::yuyv_color, and only converted to RGB when asked for.
+   * Takes effect at the next Start(). Defaults to false.
+   */
+  void set_yuyv_color(bool flag) {
+    yuyv_color_ = flag;
+  }
+
+  /**
+   * Widens the 8 bit IR images the camera delivers to 16 bits (value * 256),
+   * which is how they used to be published, instead of passing them on as
+   * they are. Defaults to false.
+   */
+  void set_ir_16bit(bool flag) {
+    ir_16bit_ = flag;
+  }
+
+  int get_image_scalar_size(const ImageType type) const override {
+    if (is_infrared_image(type) && ir_16bit_) return 2;
+    return RGBDSensor::get_image_scalar_size(type);
+  }
+
  private:
   void DoStart(const std::vector<ImageType>& types) override;
   void DoStop() override;
@@ -67,6 +96,16 @@ class RealSenseD400 : public RGBDSensor {
 
   void PollingThread();
 
+  // Aligns the framesets from align_queue_ to color, and publishes them along
+  // with the aligned depth.
+  void AlignThread();
+
+  // Converts @p frames to images, and publishes the ones in @p images with
+  // UpdateImages().
+  void UpdateImagesFromFrames(
+      const std::map<ImageType, rs2::frame>& frames,
+      std::map<const ImageType, TimeStampedImage>* images);
+
   std::shared_ptr<rs2::context> context_;
   rs2::pipeline pipeline_;
   rs2::device camera_;
@@ -77,6 +116,8 @@ class RealSenseD400 : public RGBDSensor {
   const bool use_high_res_{false};
 
   std::atomic<bool> post_process_{false};
+  std::atomic<bool> yuyv_color_{false};
+  std::atomic<bool> ir_16bit_{false};
 
   std::map<ImageType, rs2::stream_profile> supported_streams_;
 
@@ -85,6 +126,11 @@ class RealSenseD400 : public RGBDSensor {
   std::atomic<bool> run_{false};
   mutable std::mutex lock_;
   std::thread thread_;
+
+  // Only holds the latest frameset, so that alignment skips frames rather
+  // than falling behind.
+  rs2::frame_queue align_queue_{1};
+  std::thread align_thread_;
 };
 
 }  // namespace rs2_lcm
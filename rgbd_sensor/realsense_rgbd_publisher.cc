@@ -1,11 +1,19 @@
 /// @file
 ///
 /// Open RealSense cameras and run the RGBD publisher.
+#include <poll.h>
+
+#include <cerrno>
 #include <chrono>
+#include <sstream>
 #include <string>
+#include <system_error>
+#include <vector>
 
 #include <drake/common/text_logging.h>
 #include <gflags/gflags.h>
+#include "rgbd_sensor/compression_policy.h"
+#include "rgbd_sensor/lcm_point_cloud_publisher.h"
 #include "rgbd_sensor/lcm_rgbd_common.h"
 #include "rgbd_sensor/lcm_rgbd_publisher.h"
 #include "rgbd_sensor/real_sense_d400.h"
@@ -24,9 +32,56 @@ DEFINE_bool(hardware_depth_registration, false,
             "Enable hardware depth registration");
 DEFINE_bool(software_depth_registration, false,
             "Enable software depth registration");
+DEFINE_bool(software_color_registration, false,
+            "Also publish color registered to the depth image "
+            "(DEPTH_ALIGNED_RGB). Ignored with --hardware_depth_registration");
 DEFINE_bool(ir, true, "Publish IR images along with RGB and DEPTH");
+DEFINE_bool(ir_16bit, false,
+            "Publish IR as 16 bit (value * 256) images, as it used to be, "
+            "rather than the 8 bits the camera delivers");
 DEFINE_bool(use_high_res, false,
             "Use in high res mode (1280X720) instead of the default (848X480)");
+DEFINE_bool(yuyv_color, false,
+            "Capture color as YUYV rather than RGB. JPEG encodes it without "
+            "converting, and RGB is only computed when something needs it, "
+            "e.g. software registration");
+DEFINE_bool(point_cloud, false,
+            "Also publish point clouds computed from depth. Adds "
+            "DEPTH to the published images with --hardware_depth_registration");
+DEFINE_bool(point_cloud_color, false,
+            "Publish XYZRGB rather than XYZ point clouds");
+DEFINE_double(point_cloud_rate, 5.0,
+              "Maximum rate (Hz) at which point clouds are published");
+DEFINE_string(point_cloud_channel_prefix, "DRAKE_POINT_CLOUD_",
+              "Point clouds are published on this prefix + the camera id");
+DEFINE_string(point_cloud_voxel_size, "0",
+              "Voxel grid size (m) to thin point clouds with, 0 to publish "
+              "organized clouds. Either one value, or a comma separated "
+              "value per camera");
+DEFINE_string(depth_decimation, "1",
+              "Factor to decimate DEPTH images by before registration, "
+              "point clouds and encoding. Either one value, or a comma "
+              "separated value per camera. With "
+              "--hardware_depth_registration the aligned depth "
+              "(RECT_RGB_ALIGNED_DEPTH) is not decimated, only the DEPTH "
+              "stream --point_cloud adds is");
+DEFINE_string(depth_decimation_method, "median",
+              "How blocks are decimated: stride, median or min. Either one "
+              "value, or a comma separated value per camera");
+DEFINE_string(depth_compression, "",
+              "Codec of published depth images, e.g. zlib, rvl or zstd. "
+              "Shorthand for --compression=DEPTH=...,"
+              "DEPTH_ALIGNED_TO_RECTIFIED_RGB=...");
+DEFINE_string(compression_config, "",
+              "JSON file with per camera, per stream codec settings, see "
+              "CompressionPolicy::LoadJson(). Applied after "
+              "--depth_compression");
+DEFINE_string(compression, "",
+              "Per stream codec settings, applied last, as comma separated "
+              "[camera_id/]STREAM=codec[:OPTION=N]..., with the options "
+              "level, quality, threads, shuffle and subsampling, e.g. "
+              "DEPTH=zstd:level=1,RGB=jpeg:quality=80:subsampling=422. "
+              "Codecs: raw, zlib, jpeg, png, rvl, lz4, zstd");
 DEFINE_string(
     json_config_file, "",
     "JSON configuration file for camera settings. Note that this "
@@ -36,11 +91,46 @@ DEFINE_string(
 namespace rs2_lcm {
 namespace {
 
+// Returns the value for camera @p index from @p value, a per camera flag
+// holding either one value for all cameras or a comma separated list with
+// one value per camera.
+std::string GetPerCameraValue(const std::string& flag_name,
+                              const std::string& value, int num_cameras,
+                              int index) {
+  std::vector<std::string> values;
+  std::stringstream stream(value);
+  std::string entry;
+  while (std::getline(stream, entry, ',')) values.push_back(entry);
+  if (values.size() == 1) return values[0];
+  if (static_cast<int>(values.size()) != num_cameras) {
+    throw std::runtime_error("--" + flag_name + " must have one value, or " +
+                             std::to_string(num_cameras) + " values.");
+  }
+  return values.at(index);
+}
+
+CompressionPolicy MakeCompressionPolicy() {
+  CompressionPolicy policy;
+  if (!FLAGS_depth_compression.empty()) {
+    CodecSettings settings;
+    settings.codec = FLAGS_depth_compression;
+    policy.Set(ImageType::DEPTH, settings);
+    policy.Set(ImageType::RECT_RGB_ALIGNED_DEPTH, settings);
+  }
+  if (!FLAGS_compression_config.empty()) {
+    policy.LoadJson(FLAGS_compression_config);
+  }
+  policy.ParseSpec(FLAGS_compression);
+  return policy;
+}
+
 int RunRgbdPublisher(const std::vector<std::unique_ptr<RGBDSensor>>& devices,
                      const std::vector<ImageType>& image_types,
-                     ImageType depth_type, bool request_software_registration) {
-  drake::log()->info("Request software depth registration: {}",
-                     request_software_registration);
+                     ImageType depth_type,
+                     const std::vector<ImageType>& software_types,
+                     const CompressionPolicy& compression_policy) {
+  drake::log()->info("Request software registration of {} image types",
+                     software_types.size());
 
   for (size_t i = 0; i < devices.size(); ++i) {
     RGBDSensor* sensor = devices[i].get();
@@ -56,7 +146,6 @@ int RunRgbdPublisher(const std::vector<std::unique_ptr<RGBDSensor>>& devices,
     return 0;
   }
 
-
   lcm::LCM lcm;
   std::vector<LcmRgbdPublisher> publishers;
   for (size_t i = 0; i < devices.size(); ++i) {
@@ -65,38 +154,84 @@ int RunRgbdPublisher(const std::vector<std::unique_ptr<RGBDSensor>>& devices,
         sensor->get_enabled_image_types();
 
     std::vector<ImageType> requested_image_types = enabled_image_types;
-    if (request_software_registration) {
-      requested_image_types.push_back(ImageType::RECT_RGB_ALIGNED_DEPTH);
-    }
+    requested_image_types.insert(requested_image_types.end(),
+                                 software_types.begin(), software_types.end());
 
     publishers.emplace_back(
         requested_image_types, sensor->camera_id(), "DRAKE_RGBD_CAMERAS",
         "DRAKE_RGBD_CAMERA_IMAGES_" + sensor->camera_id(), sensor, &lcm);
+    publishers.back().set_compression_policy(compression_policy);
+  }
+
+  std::vector<LcmPointCloudPublisher> cloud_publishers;
+  if (FLAGS_point_cloud) {
+    for (const auto& device : devices) {
+      cloud_publishers.emplace_back(
+          device->camera_id(),
+          FLAGS_point_cloud_channel_prefix + device->camera_id(),
+          FLAGS_point_cloud_color, device.get(), &lcm);
+      cloud_publishers.back().set_voxel_size(std::stof(GetPerCameraValue(
+          "point_cloud_voxel_size", FLAGS_point_cloud_voxel_size,
+          devices.size(), cloud_publishers.size() - 1)));
+    }
+  }
+  const auto cloud_period =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / FLAGS_point_cloud_rate));
+  std::vector<std::chrono::steady_clock::time_point> last_cloud_sent(
+      devices.size());
+
+  // Wait on every camera's new frame fd and on lcm, so that images are
+  // published as soon as they arrive.
+  std::vector<pollfd> fds;
+  for (const auto& device : devices) {
+    fds.push_back(pollfd{device->new_frame_fd(), POLLIN, 0});
   }
+  fds.push_back(pollfd{lcm.getFileno(), POLLIN, 0});
+  pollfd& lcm_fd = fds.back();
 
+  const auto kDescriptionPeriod = std::chrono::milliseconds(500);
   // Set the last description time in the past so that we publish immediately.
   auto last_description_sent =
-      std::chrono::system_clock::now() - std::chrono::hours(1);
-  std::vector<uint64_t> last_depth_timestamp(devices.size(), 0);
+      std::chrono::steady_clock::now() - std::chrono::hours(1);
+  std::vector<uint64_t> last_depth_sequence(devices.size(), 0);
   while (true) {
-    auto now = std::chrono::system_clock::now();
-    if (now - last_description_sent > std::chrono::milliseconds(500)) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_description_sent > kDescriptionPeriod) {
       for (LcmRgbdPublisher& publisher : publishers) {
         publisher.PublishDescription();
         last_description_sent = now;
       }
     }
 
-    uint64_t depth_timestamp = 0;
+    const auto until_description =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            last_description_sent + kDescriptionPeriod - now);
+    if (poll(fds.data(), fds.size(), until_description.count() + 1) < 0) {
+      if (errno == EINTR) continue;
+      throw std::system_error(errno, std::generic_category(), "poll");
+    }
+
     for (size_t i = 0; i < devices.size(); ++i) {
-      devices[i]->GetLatestImage(depth_type, &depth_timestamp);
-      if (depth_timestamp != last_depth_timestamp[i]) {
+      if (!(fds[i].revents & POLLIN)) continue;
+      devices[i]->ClearNewFrameFd();
+      const uint64_t depth_sequence =
+          devices[i]->get_image_sequence(depth_type);
+      if (depth_sequence != last_depth_sequence[i]) {
         publishers[i].PublishImages();
-        last_depth_timestamp[i] = depth_timestamp;
+        last_depth_sequence[i] = depth_sequence;
+
+        const auto cloud_now = std::chrono::steady_clock::now();
+        if (!cloud_publishers.empty() &&
+            cloud_now - last_cloud_sent[i] >= cloud_period) {
+          cloud_publishers[i].PublishPointCloud();
+          last_cloud_sent[i] = cloud_now;
+        }
       }
     }
-    // Run at 200hz (arbitrary).
-    lcm.handleTimeout(5);
+    if (lcm_fd.revents & POLLIN) {
+      lcm.handleTimeout(0);
+    }
   }
 
   return 0;
@@ -107,27 +242,48 @@ int DoMain() {
                                       ? ImageType::RECT_RGB_ALIGNED_DEPTH
                                       : ImageType::DEPTH;
 
-  bool request_software_registration =
-      FLAGS_software_depth_registration && !FLAGS_hardware_depth_registration;
+  // Software registration needs the unaligned depth image.
+  std::vector<ImageType> software_types;
+  if (!FLAGS_hardware_depth_registration) {
+    if (FLAGS_software_depth_registration) {
+      software_types.push_back(ImageType::RECT_RGB_ALIGNED_DEPTH);
+    }
+    if (FLAGS_software_color_registration) {
+      software_types.push_back(ImageType::DEPTH_ALIGNED_RGB);
+    }
+  }
 
   std::vector<ImageType> image_types;
   image_types.push_back(ImageType::RGB);
   image_types.push_back(hardware_depth_type);
+  // Point clouds are computed from the unaligned depth image.
+  if (FLAGS_point_cloud && hardware_depth_type != ImageType::DEPTH) {
+    image_types.push_back(ImageType::DEPTH);
+  }
   if (FLAGS_ir) {
     image_types.push_back(ImageType::IR);
     image_types.push_back(ImageType::IR_STEREO);
   }
 
+  if (FLAGS_point_cloud && !(FLAGS_point_cloud_rate > 0)) {
+    throw std::runtime_error("--point_cloud_rate must be positive.");
+  }
+
   if (!FLAGS_serial.empty() && FLAGS_num_cameras != 1) {
     throw std::runtime_error("--serial requires --num_cameras=1.");
   }
 
+  // Malformed settings fail before any camera is opened.
+  const CompressionPolicy compression_policy = MakeCompressionPolicy();
+
   std::vector<std::unique_ptr<RGBDSensor>> sensors;
   int i = 0;
   while (static_cast<int>(sensors.size()) < FLAGS_num_cameras) {
-    std::unique_ptr<RGBDSensor> sensor;
-    sensor = std::make_unique<RealSenseD400>(
+    auto realsense = std::make_unique<RealSenseD400>(
         i, FLAGS_use_high_res, FLAGS_json_config_file);
+    realsense->set_yuyv_color(FLAGS_yuyv_color);
+    realsense->set_ir_16bit(FLAGS_ir_16bit);
+    std::unique_ptr<RGBDSensor> sensor = std::move(realsense);
     ++i;
 
     if (!FLAGS_serial.empty()) {
@@ -136,6 +292,27 @@ int DoMain() {
       if (sensor->camera_id() != FLAGS_serial)
         continue;
     }
+    const int index = sensors.size();
+    const int decimation_factor = std::stoi(GetPerCameraValue(
+        "depth_decimation", FLAGS_depth_decimation, FLAGS_num_cameras, index));
+    // Only DEPTH is decimated, not the aligned depth the camera registers.
+    if (decimation_factor > 1 && FLAGS_hardware_depth_registration) {
+      if (!FLAGS_point_cloud) {
+        throw std::runtime_error(
+            "--depth_decimation has no effect with "
+            "--hardware_depth_registration unless --point_cloud is set.");
+      }
+      drake::log()->warn(
+          "With --hardware_depth_registration, --depth_decimation does not "
+          "apply to the aligned depth (RECT_RGB_ALIGNED_DEPTH), only to the "
+          "DEPTH stream added for --point_cloud, which is published "
+          "decimated.");
+    }
+    sensor->set_depth_decimation(
+        decimation_factor,
+        StringToDecimationMethod(GetPerCameraValue(
+            "depth_decimation_method", FLAGS_depth_decimation_method,
+            FLAGS_num_cameras, index)));
     sensors.push_back(std::move(sensor));
   }
 
@@ -144,7 +321,7 @@ int DoMain() {
   }
 
   return RunRgbdPublisher(sensors, image_types, hardware_depth_type,
-                          request_software_registration);
+                          software_types, compression_policy);
 }
 
 }  // namespace
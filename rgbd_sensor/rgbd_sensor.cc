@@ -1,8 +1,39 @@
 #include "rgbd_sensor/rgbd_sensor.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <system_error>
+
 #include <spdlog/fmt/ostr.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <drake/common/text_logging.h>
+#include "rgbd_sensor/image_conversions.h"
 
 namespace rs2_lcm {
+namespace {
+
+// Number of memoized derived images. A few frames worth, so that consumers
+// running a frame behind still share the work.
+constexpr size_t kMaxDerivedImages = 8;
+
+// Returns *@p pool, replaced first if its buffers are not @p size bytes.
+// Outstanding buffers of a replaced pool are freed once released.
+std::shared_ptr<ImageBufferPool> GetPool(
+    std::shared_ptr<ImageBufferPool>* pool, size_t size) {
+  if (!*pool || (*pool)->buffer_size() != size) {
+    *pool = ImageBufferPool::Make(size);
+  }
+  return *pool;
+}
+
+}  // namespace
 
 RGBDSensor::RGBDSensor(const std::vector<ImageType>& supported_types)
     : supported_types_(supported_types) {
@@ -27,8 +58,15 @@ RGBDSensor::RGBDSensor(const std::vector<ImageType>& supported_types)
     throw std::runtime_error(
         "RGBDSensor has to support at least one color ImageType.");
   }
+
+  new_frame_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (new_frame_fd_ < 0) {
+    throw std::system_error(errno, std::generic_category(), "eventfd");
+  }
 }
 
+RGBDSensor::~RGBDSensor() { close(new_frame_fd_); }
+
 void RGBDSensor::Start(const std::vector<ImageType>& types) {
   for (const auto& type : types) {
     if (!supports(type)) {
@@ -37,16 +75,52 @@ void RGBDSensor::Start(const std::vector<ImageType>& types) {
     }
   }
 
-  // Initialize the images and cloud to nullptrs.
+  // Initialize the images to nullptrs.
+  std::atomic_store(&frameset_, std::make_shared<const ImageFrameset>());
   {
-    std::map<const ImageType, TimeStampedImage> images;
-    for (const auto& type : types) images[type] = TimeStampedImage();
+    // Timestamps may start over.
+    std::unique_lock<std::mutex> lock(derived_lock_);
+    derived_images_.clear();
+  }
+  for (int i = 0; i < kNumImageTypes; i++) {
+    const bool enabled =
+        std::find(types.begin(), types.end(), static_cast<ImageType>(i)) !=
+        types.end();
+    slots_[i].sequence.store(0, std::memory_order_release);
+    histories_[i].Reset(enabled ? history_depth_.load() : 0);
+    slots_[i].enabled.store(enabled, std::memory_order_release);
+  }
 
-    std::unique_lock<std::mutex> lock(data_lock_);
-    images_ = images;
+  // Decimated intrinsics go in before any image arrives, so that consumers
+  // never pair a decimated image with the full resolution calibration.
+  const int factor = depth_decimation_factor_;
+  const DecimationMethod method = depth_decimation_method_;
+  {
+    std::unique_lock<std::mutex> lock(params_lock_);
+    auto depth_intrinsics = intrinsics_.find(ImageType::DEPTH);
+    if (undecimated_depth_intrinsics_) {
+      // Started again without Stop().
+      depth_intrinsics->second = *undecimated_depth_intrinsics_;
+      undecimated_depth_intrinsics_.reset();
+    }
+    if (factor > 1 && depth_intrinsics != intrinsics_.end()) {
+      undecimated_depth_intrinsics_ =
+          std::make_unique<Intrinsics>(depth_intrinsics->second);
+      depth_intrinsics->second =
+          DecimateIntrinsics(depth_intrinsics->second, factor, method);
+    }
+    ray_tables_.erase(ImageType::DEPTH);
+    calibration_generation_++;
   }
+  active_decimation_method_.store(method, std::memory_order_release);
+  active_decimation_factor_.store(factor, std::memory_order_release);
 
-  DoStart(types);
+  try {
+    DoStart(types);
+  } catch (...) {
+    RestoreDepthIntrinsics();
+    throw;
+  }
 
   std::vector<ImageType> enabled_types = get_enabled_image_types();
 
@@ -69,10 +143,14 @@ void RGBDSensor::Start(const std::vector<ImageType>& types) {
 
 void RGBDSensor::Stop() {
   DoStop();
+  RestoreDepthIntrinsics();
 
-  // Clears all the images and point clouds.
-  std::unique_lock<std::mutex> lock(data_lock_);
-  images_ = {};
+  // Clears all the images.
+  for (int i = 0; i < kNumImageTypes; i++) {
+    slots_[i].enabled.store(false, std::memory_order_release);
+    histories_[i].Reset(0);
+  }
+  std::atomic_store(&frameset_, std::make_shared<const ImageFrameset>());
 }
 
 bool RGBDSensor::supports(const ImageType type) const {
@@ -80,34 +158,305 @@ bool RGBDSensor::supports(const ImageType type) const {
          supported_types_.end();
 }
 
+void RGBDSensor::set_depth_decimation(int factor, DecimationMethod method) {
+  if (factor < 1) {
+    throw std::runtime_error("Depth decimation factor must be positive");
+  }
+  depth_decimation_factor_ = factor;
+  depth_decimation_method_ = method;
+}
+
+void RGBDSensor::RestoreDepthIntrinsics() {
+  active_decimation_factor_.store(1, std::memory_order_release);
+  std::unique_lock<std::mutex> lock(params_lock_);
+  if (!undecimated_depth_intrinsics_) return;
+  intrinsics_[ImageType::DEPTH] = *undecimated_depth_intrinsics_;
+  undecimated_depth_intrinsics_.reset();
+  ray_tables_.erase(ImageType::DEPTH);
+  calibration_generation_++;
+}
+
 void RGBDSensor::UpdateImages(
     const std::map<const ImageType, TimeStampedImage>& new_images) {
-  std::unique_lock<std::mutex> lock(data_lock_);
-  // Only update the new images.
-  for (const auto& new_pair : new_images) {
-    images_[new_pair.first] = new_pair.second;
+  auto depth = new_images.find(ImageType::DEPTH);
+  if (depth != new_images.end() && depth->second.data &&
+      active_decimation_factor_.load(std::memory_order_acquire) > 1) {
+    // Decimated before publishing, so that registration, point clouds and
+    // encoding never touch the full resolution image.
+    std::map<const ImageType, TimeStampedImage> decimated = new_images;
+    decimated.at(ImageType::DEPTH).data =
+        DecimateDepthImage(*depth->second.data);
+    PublishImages(decimated);
+  } else {
+    PublishImages(new_images);
+  }
+}
+
+std::shared_ptr<const RawImageData> RGBDSensor::DecimateDepthImage(
+    const RawImageData& depth) {
+  const int factor = active_decimation_factor_.load(std::memory_order_acquire);
+  const int rows = depth.rows() / factor;
+  const int cols = depth.cols() / factor;
+  std::shared_ptr<ImageBufferPool> pool;
+  {
+    std::unique_lock<std::mutex> lock(pools_lock_);
+    pool = GetPool(&decimation_pool_,
+                   static_cast<size_t>(rows) * cols * sizeof(uint16_t));
   }
+  std::shared_ptr<RawImageData> decimated =
+      pool->MakeImage(rows, cols, 1, sizeof(uint16_t));
+  DecimateDepth(depth, factor,
+                active_decimation_method_.load(std::memory_order_acquire),
+                decimated.get());
+  return decimated;
+}
+
+void RGBDSensor::PublishImages(
+    const std::map<const ImageType, TimeStampedImage>& new_images) {
+  // The history only holds RGB, so YUYV color has to be converted for it.
+  // That happens before taking update_lock_, so that other writers do not
+  // wait for it.
+  std::shared_ptr<const YuyvColorImage> yuyv_color;
+  auto rgb = new_images.find(ImageType::RGB);
+  if (rgb != new_images.end() && rgb->second.data &&
+      rgb->second.data->channels() == 2) {
+    yuyv_color = std::make_shared<const YuyvColorImage>(rgb->second.data);
+    if (histories_.at(static_cast<int>(ImageType::RGB)).capacity() > 0) {
+      yuyv_color->rgb();
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(update_lock_);
+    auto frameset =
+        std::make_shared<ImageFrameset>(*std::atomic_load(&frameset_));
+    frameset->sequence++;
+    // Only update the new images.
+    for (const auto& new_pair : new_images) {
+      const int index = static_cast<int>(new_pair.first);
+      const std::shared_ptr<const RawImageData>& data = new_pair.second.data;
+      if (new_pair.first == ImageType::RGB) {
+        frameset->yuyv_color = yuyv_color;
+        frameset->images.at(index) = yuyv_color ? nullptr : data;
+      } else {
+        frameset->images.at(index) = data;
+      }
+      frameset->timestamps.at(index) = new_pair.second.timestamp;
+    }
+    std::atomic_store(&frameset_,
+                      std::shared_ptr<const ImageFrameset>(frameset));
+
+    for (const auto& new_pair : new_images) {
+      ImageHistory& history = histories_.at(static_cast<int>(new_pair.first));
+      if (new_pair.first == ImageType::RGB && frameset->yuyv_color) {
+        // Already converted above.
+        if (history.capacity() > 0) {
+          history.Push(new_pair.second.timestamp,
+                       frameset->yuyv_color->rgb());
+        }
+      } else {
+        history.Push(new_pair.second.timestamp, new_pair.second.data);
+      }
+      ImageSlot& slot = slots_.at(static_cast<int>(new_pair.first));
+      slot.enabled.store(true, std::memory_order_release);
+      slot.sequence.fetch_add(1, std::memory_order_acq_rel);
+    }
+  }
+
+  // Taking the lock orders the sequence updates with a waiter that has just
+  // checked them, so that no wake up is lost.
+  { std::unique_lock<std::mutex> lock(new_frame_lock_); }
+  new_frame_cv_.notify_all();
+
+  const uint64_t one = 1;
+  if (write(new_frame_fd_, &one, sizeof(one)) != sizeof(one) &&
+      errno != EAGAIN) {
+    drake::log()->warn("Failed to signal new frame: {}", strerror(errno));
+  }
+}
+
+uint64_t RGBDSensor::WaitForNewFrame(const ImageType type, uint64_t last_seen,
+                                     std::chrono::microseconds timeout) const {
+  uint64_t sequence = get_image_sequence(type);
+  if (sequence != last_seen) return sequence;
+
+  std::unique_lock<std::mutex> lock(new_frame_lock_);
+  new_frame_cv_.wait_for(lock, timeout, [&]() {
+    sequence = get_image_sequence(type);
+    return sequence != last_seen;
+  });
+  return sequence;
+}
+
+void RGBDSensor::ClearNewFrameFd() const {
+  uint64_t count;
+  if (read(new_frame_fd_, &count, sizeof(count)) != sizeof(count) &&
+      errno != EAGAIN) {
+    drake::log()->warn("Failed to clear new frame fd: {}", strerror(errno));
+  }
+}
+
+std::shared_ptr<const RawImageData> RGBDSensor::GetImageNearest(
+    const ImageType type, uint64_t timestamp,
+    uint64_t* image_timestamp) const {
+  ImageHistory::Entry entry =
+      histories_.at(static_cast<int>(type)).GetNearest(timestamp);
+  *image_timestamp = entry.timestamp;
+  return entry.image;
+}
+
+std::shared_ptr<RawImageData> RGBDSensor::MakePooledImage(ImageType type,
+                                                          int rows, int cols,
+                                                          int channels,
+                                                          int element_size) {
+  const size_t size = static_cast<size_t>(rows) * cols * element_size;
+  std::shared_ptr<ImageBufferPool> pool;
+  {
+    std::unique_lock<std::mutex> lock(pools_lock_);
+    // Resolution changes replace the pool.
+    pool = GetPool(&pools_[type], size);
+  }
+  return pool->MakeImage(rows, cols, channels, element_size);
+}
+
+YuyvColorImage::YuyvColorImage(std::shared_ptr<const RawImageData> yuyv)
+    : yuyv_(std::move(yuyv)) {
+  if (!yuyv_ || yuyv_->channels() != 2 || yuyv_->scalar_size() != 1 ||
+      yuyv_->cols() % 2 != 0) {
+    throw std::runtime_error("Invalid YUYV image");
+  }
+}
+
+const std::shared_ptr<const RawImageData>& YuyvColorImage::rgb() const {
+  std::call_once(converted_, [this]() {
+    auto rgb = std::make_shared<RawImageData>(RawImageData::MakeUninitialized(
+        yuyv_->rows(), yuyv_->cols(), 3, 3));
+    YuyvToRgb(yuyv_->data(), yuyv_->cols() * 2, yuyv_->cols(),
+              yuyv_->rows(), rgb->data());
+    rgb_ = std::move(rgb);
+  });
+  return rgb_;
 }
 
 std::shared_ptr<const RawImageData> RGBDSensor::GetLatestImage(
     const ImageType type, uint64_t* timestamp) const {
-  std::unique_lock<std::mutex> lock(data_lock_);
-  auto it = images_.find(type);
-  if (it == images_.end()) {
-    *timestamp = 0;
-    return nullptr;
+  return GetLatestFrameset()->image(type, timestamp);
+}
+
+std::shared_ptr<const RayTable> RGBDSensor::get_ray_table(
+    ImageType type) const {
+  std::unique_lock<std::mutex> lock(params_lock_);
+  return GetRayTableLocked(type);
+}
+
+std::shared_ptr<const RayTable> RGBDSensor::GetRayTableLocked(
+    ImageType type) const {
+  std::shared_ptr<const RayTable>& table = ray_tables_[type];
+  if (!table) {
+    auto intrinsics = intrinsics_.find(type);
+    if (intrinsics == intrinsics_.end()) {
+      ray_tables_.erase(type);
+      throw std::runtime_error("Missing intrinsics for: " +
+                               ImageTypeToString(type));
+    }
+    table = std::make_shared<const RayTable>(intrinsics->second);
   }
-  const TimeStampedImage& image = it->second;
-  *timestamp = image.timestamp;
-  return image.data;
+  return table;
 }
 
-RawImageData DoRegisterDepthToColor(const Intrinsics& color_intrinsics,
-                                    const Intrinsics& depth_intrinsics,
-                                    const Eigen::Isometry3f& X_rgb_depth,
-                                    const RawImageData& color,
-                                    const RawImageData& depth,
-                                    ImageType depth_type) {
+std::shared_ptr<const RawImageData> RGBDSensor::GetDerivedImage(
+    ImageType type, const ImageFrameset& frameset) const {
+  DerivedKind kind;
+  switch (type) {
+    case ImageType::RECT_RGB_ALIGNED_DEPTH:
+      kind = DerivedKind::kAlignedDepth;
+      break;
+    case ImageType::DEPTH_ALIGNED_RGB:
+      kind = DerivedKind::kAlignedColor;
+      break;
+    default:
+      throw std::runtime_error("Can not derive: " + ImageTypeToString(type));
+  }
+  return GetDerived(kind, frameset, GetRegistrationCalibration());
+}
+
+std::shared_ptr<const RawImageData> RGBDSensor::GetColorUvMap(
+    const ImageFrameset& frameset) const {
+  return GetDerived(DerivedKind::kColorUvMap, frameset,
+                    GetRegistrationCalibration());
+}
+
+RGBDSensor::RegistrationCalibration RGBDSensor::GetRegistrationCalibration()
+    const {
+  std::unique_lock<std::mutex> lock(params_lock_);
+  RegistrationCalibration calibration;
+  calibration.color_intrinsics = intrinsics_.at(ImageType::RGB);
+  calibration.depth_rays = GetRayTableLocked(ImageType::DEPTH);
+  calibration.X_rgb_depth = extrinsics_.at(
+      std::pair<ImageType, ImageType>(ImageType::DEPTH, ImageType::RGB));
+  calibration.generation = calibration_generation_;
+  return calibration;
+}
+
+std::shared_ptr<const RawImageData> RGBDSensor::GetDerived(
+    DerivedKind kind, const ImageFrameset& frameset,
+    const RegistrationCalibration& calibration) const {
+  DerivedImageKey key{kind, 0, 0, calibration.generation};
+  const auto& depth = frameset.image(ImageType::DEPTH, &key.depth_timestamp);
+  const auto& color = frameset.image(ImageType::RGB, &key.color_timestamp);
+  if (!depth || !color) return nullptr;
+
+  std::promise<std::shared_ptr<const RawImageData>> promise;
+  {
+    std::unique_lock<std::mutex> lock(derived_lock_);
+    for (const auto& entry : derived_images_) {
+      if (entry.first == key) {
+        DerivedImageFuture future = entry.second;
+        lock.unlock();
+        return future.get();
+      }
+    }
+    derived_images_.emplace_back(key, promise.get_future().share());
+    if (derived_images_.size() > kMaxDerivedImages) {
+      derived_images_.pop_front();
+    }
+  }
+
+  // Computed without holding derived_lock_, so that other images can be
+  // looked up (or derived from this one) meanwhile.
+  try {
+    std::shared_ptr<const RawImageData> image;
+    switch (kind) {
+      case DerivedKind::kAlignedDepth:
+        image = std::make_shared<const RawImageData>(DoRegisterDepthToColor(
+            calibration.color_intrinsics, *calibration.depth_rays,
+            calibration.X_rgb_depth, *color, *depth, ImageType::DEPTH));
+        break;
+      case DerivedKind::kAlignedColor:
+        image = std::make_shared<const RawImageData>(DoRegisterColorToDepth(
+            *color,
+            *GetDerived(DerivedKind::kColorUvMap, frameset, calibration)));
+        break;
+      case DerivedKind::kColorUvMap:
+        image = std::make_shared<const RawImageData>(DoComputeColorUvMap(
+            calibration.color_intrinsics, *calibration.depth_rays,
+            calibration.X_rgb_depth, *depth));
+        break;
+    }
+    promise.set_value(image);
+    return image;
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+namespace {
+
+void CheckRegistrationInputs(const Intrinsics& color_intrinsics,
+                             const Intrinsics& depth_intrinsics,
+                             const RawImageData& color,
+                             const RawImageData& depth) {
   if (depth_intrinsics.width() != depth.cols() ||
       depth_intrinsics.height() != depth.rows()) {
     throw std::runtime_error("Depth image dimension mismatch");
@@ -122,45 +471,223 @@ RawImageData DoRegisterDepthToColor(const Intrinsics& color_intrinsics,
   if (color.channels() != 3 || color.scalar_size() != 1) {
     throw std::runtime_error("Color image format is incorrect");
   }
+}
+
+// Number of depth rows per registration task.
+constexpr int kRegistrationGrainRows = 16;
+
+// Lowers the depth at @p pixel to @p z, where 0 means no data, without locks.
+void AtomicMinDepth(std::atomic<uint16_t>* pixel, uint16_t z) {
+  uint16_t current = pixel->load(std::memory_order_relaxed);
+  while ((current == 0 || current > z) &&
+         !pixel->compare_exchange_weak(current, z,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+// Sets (@p px, @p py) to the pixel nearest to (@p u, @p v), and returns
+// whether it lies in a @p cols x @p rows image. The range is checked before
+// converting to int, which is undefined for NaN, infinite or far off
+// coordinates.
+bool NearestPixel(float u, float v, int cols, int rows, int* px, int* py) {
+  const float round_u = std::round(u);
+  const float round_v = std::round(v);
+  // Also false for NaN.
+  if (!(round_u >= 0 && round_v >= 0 && round_u < cols && round_v < rows)) {
+    return false;
+  }
+  *px = static_cast<int>(round_u);
+  *py = static_cast<int>(round_v);
+  return true;
+}
+
+// Back projects row @p v of a depth image, @p depth_row, with @p depth_rays,
+// transforms the points to the color frame as (@p X, @p Y, @p Z), and
+// projects them to color pixels (@p pu, @p pv). All outputs must have one
+// entry per depth column.
+void ProjectDepthRow(const Intrinsics& color_intrinsics,
+                     const RayTable& depth_rays,
+                     const Eigen::Isometry3f& X_rgb_depth,
+                     const uint16_t* depth_row, int v, Eigen::ArrayXf* X,
+                     Eigen::ArrayXf* Y, Eigen::ArrayXf* Z, Eigen::ArrayXf* pu,
+                     Eigen::ArrayXf* pv) {
+  const int cols = depth_rays.width();
+  const Eigen::Matrix3f R = X_rgb_depth.linear();
+  const Eigen::Vector3f t = X_rgb_depth.translation();
+  const Eigen::ArrayXf z =
+      Eigen::Map<const Eigen::Array<uint16_t, Eigen::Dynamic, 1>>(depth_row,
+                                                                  cols)
+          .cast<float>() /
+      1000.f;
+  const Eigen::ArrayXf x =
+      z * Eigen::Map<const Eigen::ArrayXf>(depth_rays.x_data() + v * cols,
+                                           cols);
+  const Eigen::ArrayXf y =
+      z * Eigen::Map<const Eigen::ArrayXf>(depth_rays.y_data() + v * cols,
+                                           cols);
+  *X = R(0, 0) * x + R(0, 1) * y + R(0, 2) * z + t(0);
+  *Y = R(1, 0) * x + R(1, 1) * y + R(1, 2) * z + t(1);
+  *Z = R(2, 0) * x + R(2, 1) * y + R(2, 2) * z + t(2);
+  color_intrinsics.ProjectBatch(X->data(), Y->data(), Z->data(), cols,
+                                pu->data(), pv->data());
+}
+
+}  // namespace
+
+RawImageData DoRegisterDepthToColor(const Intrinsics& color_intrinsics,
+                                    const Intrinsics& depth_intrinsics,
+                                    const Eigen::Isometry3f& X_rgb_depth,
+                                    const RawImageData& color,
+                                    const RawImageData& depth,
+                                    ImageType depth_type) {
+  if (depth_type == ImageType::RECT_RGB_ALIGNED_DEPTH) {
+    CheckRegistrationInputs(color_intrinsics, depth_intrinsics, color, depth);
+    return depth;
+  }
+  return DoRegisterDepthToColor(color_intrinsics, RayTable(depth_intrinsics),
+                                X_rgb_depth, color, depth, depth_type);
+}
+
+RawImageData DoRegisterDepthToColor(const Intrinsics& color_intrinsics,
+                                    const RayTable& depth_rays,
+                                    const Eigen::Isometry3f& X_rgb_depth,
+                                    const RawImageData& color,
+                                    const RawImageData& depth,
+                                    ImageType depth_type) {
+  CheckRegistrationInputs(color_intrinsics, depth_rays.intrinsics(), color,
+                          depth);
 
   if (depth_type == ImageType::RECT_RGB_ALIGNED_DEPTH) {
     return depth;
   }
 
-  RawImageData depth_registered(color.rows(), color.cols(), 1, 2);
-  auto depth_registered_view = depth_registered.mutable_slice<uint16_t>();
-  auto depth_view = depth.slice<uint16_t>();
-  depth_registered_view.setZero();
+  const int depth_cols = depth.cols();
+  const int color_cols = color.cols();
+  const int color_rows = color.rows();
+  // Z buffer in the color frame, 0 means no data.
+  std::unique_ptr<std::atomic<uint16_t>[]> z_buffer(
+      new std::atomic<uint16_t>[color_rows * color_cols]());
 
-  for (int v = 0; v < depth.rows(); v++) {
-    for (int u = 0; u < depth.cols(); u++) {
-      const float z = depth_view(v, u) / 1000.;
+  // Depth rows are transformed and projected in parallel tiles, a row at a
+  // time with vectorized array math. Depth pixels from different rows can
+  // land on the same color pixel, so the z buffer keeps the closest one with
+  // an atomic min, which does not depend on the order of the writes.
+  tbb::parallel_for(
+      tbb::blocked_range<int>(0, depth.rows(), kRegistrationGrainRows),
+      [&](const tbb::blocked_range<int>& rows) {
+        Eigen::ArrayXf X(depth_cols), Y(depth_cols), Z(depth_cols);
+        Eigen::ArrayXf pu(depth_cols), pv(depth_cols);
+        for (int v = rows.begin(); v < rows.end(); v++) {
+          const uint16_t* depth_row =
+              reinterpret_cast<const uint16_t*>(depth.data()) + v * depth_cols;
+          ProjectDepthRow(color_intrinsics, depth_rays, X_rgb_depth, depth_row,
+                          v, &X, &Y, &Z, &pu, &pv);
 
-      // Skip over pixels with a depth value of zero, which is used to
-      // indicate no data
-      if (z == 0) {
-        continue;
-      }
+          for (int u = 0; u < depth_cols; u++) {
+            // Skip over pixels with a depth value of zero, which is used to
+            // indicate no data
+            if (depth_row[u] == 0) continue;
 
-      const Eigen::Vector3f P_depth =
-          depth_intrinsics.BackProject(Eigen::Vector2f(u, v), z);
-      const Eigen::Vector3f P_rgb = X_rgb_depth * P_depth;
-      const Eigen::Vector2f p_rgb = color_intrinsics.Project(P_rgb);
-      const int px = static_cast<int>(std::round(p_rgb(0)));
-      const int py = static_cast<int>(std::round(p_rgb(1)));
-      if (px >= 0 && py >= 0 && px < color.cols() && py < color.rows()) {
-        if (depth_registered_view(py, px) == 0 ||
-            static_cast<float>(depth_registered_view(py, px)) >
-                P_rgb[2] * 1000.0) {
-          depth_registered_view(py, px) =
-              static_cast<uint16_t>(std::round(P_rgb[2] * 1000.0));
+            // Points behind (or at) the color camera, or beyond the range of
+            // uint16_t, can not be represented. Their projections are
+            // meaningless, and may not even be finite.
+            const double z_mm = std::round(Z[u] * 1000.0);
+            if (!(z_mm > 0 && z_mm <= std::numeric_limits<uint16_t>::max())) {
+              continue;
+            }
+            int px, py;
+            if (!NearestPixel(pu[u], pv[u], color_cols, color_rows, &px,
+                              &py)) {
+              continue;
+            }
+            AtomicMinDepth(&z_buffer[px + py * color_cols],
+                           static_cast<uint16_t>(z_mm));
+          }
         }
-      }
-    }
+      });
+
+  RawImageData depth_registered =
+      RawImageData::MakeUninitialized(color_rows, color_cols, 1, 2);
+  uint16_t* registered = reinterpret_cast<uint16_t*>(depth_registered.data());
+  for (int i = 0; i < color_rows * color_cols; i++) {
+    registered[i] = z_buffer[i].load(std::memory_order_relaxed);
   }
   // TODO(duy): Apply bilateral or Gaussian filter to interpolate pixels with no
   // depth due to discretization error
   return depth_registered;
 }
 
+RawImageData DoComputeColorUvMap(const Intrinsics& color_intrinsics,
+                                 const RayTable& depth_rays,
+                                 const Eigen::Isometry3f& X_rgb_depth,
+                                 const RawImageData& depth) {
+  if (depth_rays.width() != depth.cols() ||
+      depth_rays.height() != depth.rows()) {
+    throw std::runtime_error("Depth image dimension mismatch");
+  }
+  if (depth.channels() != 1 || depth.scalar_size() != 2) {
+    throw std::runtime_error("Depth image format is incorrect");
+  }
+
+  const int depth_cols = depth.cols();
+  RawImageData uv_map = RawImageData::MakeUninitialized(
+      depth.rows(), depth_cols, 2, 2 * sizeof(float));
+  tbb::parallel_for(
+      tbb::blocked_range<int>(0, depth.rows(), kRegistrationGrainRows),
+      [&](const tbb::blocked_range<int>& rows) {
+        Eigen::ArrayXf X(depth_cols), Y(depth_cols), Z(depth_cols);
+        Eigen::ArrayXf pu(depth_cols), pv(depth_cols);
+        for (int v = rows.begin(); v < rows.end(); v++) {
+          const uint16_t* depth_row =
+              reinterpret_cast<const uint16_t*>(depth.data()) + v * depth_cols;
+          ProjectDepthRow(color_intrinsics, depth_rays, X_rgb_depth, depth_row,
+                          v, &X, &Y, &Z, &pu, &pv);
+          float* uv_row =
+              reinterpret_cast<float*>(uv_map.data()) + 2 * v * depth_cols;
+          for (int u = 0; u < depth_cols; u++) {
+            const bool valid = depth_row[u] != 0 && Z[u] > 0 &&
+                               std::isfinite(pu[u]) && std::isfinite(pv[u]);
+            uv_row[2 * u] = valid ? pu[u] : -1.f;
+            uv_row[2 * u + 1] = valid ? pv[u] : -1.f;
+          }
+        }
+      });
+  return uv_map;
+}
+
+RawImageData DoRegisterColorToDepth(const RawImageData& color,
+                                    const RawImageData& uv_map) {
+  if (color.channels() != 3 || color.scalar_size() != 1) {
+    throw std::runtime_error("Color image format is incorrect");
+  }
+  if (uv_map.channels() != 2 || uv_map.scalar_size() != sizeof(float)) {
+    throw std::runtime_error("UV map format is incorrect");
+  }
+
+  const int cols = uv_map.cols();
+  const int color_cols = color.cols();
+  const int color_rows = color.rows();
+  // Zero filled, as pixels that do not land in the color image stay black.
+  RawImageData color_registered(uv_map.rows(), cols, 3, 3);
+  tbb::parallel_for(
+      tbb::blocked_range<int>(0, uv_map.rows(), kRegistrationGrainRows),
+      [&](const tbb::blocked_range<int>& rows) {
+        for (int v = rows.begin(); v < rows.end(); v++) {
+          const float* uv_row =
+              reinterpret_cast<const float*>(uv_map.data()) + 2 * v * cols;
+          uint8_t* out_row = color_registered.data() + 3 * v * cols;
+          for (int u = 0; u < cols; u++) {
+            int px, py;
+            if (!NearestPixel(uv_row[2 * u], uv_row[2 * u + 1], color_cols,
+                              color_rows, &px, &py)) {
+              continue;
+            }
+            memcpy(out_row + 3 * u, color.data() + 3 * (px + py * color_cols),
+                   3);
+          }
+        }
+      });
+  return color_registered;
+}
+
 }  // namespace rs2_lcm
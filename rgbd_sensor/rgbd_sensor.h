@@ -1,6 +1,12 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <limits>
 #include <map>
 #include <memory>
@@ -10,14 +16,74 @@
 #include <vector>
 
 #include <Eigen/Dense>
+#include "rgbd_sensor/depth_decimation.h"
 #include "rgbd_sensor/image.h"
+#include "rgbd_sensor/image_buffer_pool.h"
+#include "rgbd_sensor/image_history.h"
 #include "rgbd_sensor/intrinsics.h"
+#include "rgbd_sensor/ray_table.h"
 
 namespace rs2_lcm {
 
+/**
+ * An RGB image captured as YUYV (a 2 channel image of Y0 U Y1 V pixel pairs,
+ * see YuyvToRgb()), which is only converted to RGB the first time it is
+ * asked for, so that consumers which can take YUYV directly never pay for
+ * the conversion. Thread safe.
+ */
+class YuyvColorImage {
+ public:
+  explicit YuyvColorImage(std::shared_ptr<const RawImageData> yuyv);
+
+  const std::shared_ptr<const RawImageData>& yuyv() const { return yuyv_; }
+
+  /// Returns the RGB image, converting it on the first call.
+  const std::shared_ptr<const RawImageData>& rgb() const;
+
+ private:
+  const std::shared_ptr<const RawImageData> yuyv_;
+  mutable std::once_flag converted_;
+  mutable std::shared_ptr<const RawImageData> rgb_;
+};
+
+/**
+ * An immutable snapshot of the latest image of every ImageType of a sensor.
+ * All images delivered by one capture cycle become visible together, so
+ * images taken from the same frameset are always consistent with each other.
+ * Types without an image have a nullptr image and a zero timestamp.
+ */
+struct ImageFrameset {
+  /**
+   * Returns the image of @p type, and sets @p timestamp to its timestamp.
+   */
+  const std::shared_ptr<const RawImageData>& image(ImageType type,
+                                                   uint64_t* timestamp) const {
+    *timestamp = timestamps.at(static_cast<int>(type));
+    if (type == ImageType::RGB && yuyv_color) return yuyv_color->rgb();
+    return images.at(static_cast<int>(type));
+  }
+
+  /**
+   * Returns true if there is an image of @p type, without converting a
+   * YUYV color image.
+   */
+  bool has_image(ImageType type) const {
+    return images.at(static_cast<int>(type)) ||
+           (type == ImageType::RGB && yuyv_color);
+  }
+
+  /// Incremented every time the sensor publishes new images.
+  uint64_t sequence{0};
+  /// images[RGB] is nullptr while the color is captured as YUYV, image()
+  /// converts yuyv_color instead.
+  std::array<std::shared_ptr<const RawImageData>, kNumImageTypes> images;
+  std::array<uint64_t, kNumImageTypes> timestamps{};
+  std::shared_ptr<const YuyvColorImage> yuyv_color;
+};
+
 class RGBDSensor {
  public:
-  virtual ~RGBDSensor() {}
+  virtual ~RGBDSensor();
 
   /// Starts streaming images from the camera.
   ///
@@ -29,13 +95,100 @@ class RGBDSensor {
   void Stop();
 
   /**
-   * For rgb image, the channels are in RGB order.
+   * For rgb image, the channels are in RGB order, also when the color is
+   * captured as YUYV (see YuyvColorImage).
    * For depth image, each element is 16bits, in units of mm.
-   * For ir image, each element is 16 bits.
+   * For ir image, each element is 8 bits as delivered by the camera, unless
+   * the sensor is set to widen it to 16 bits.
+   * Safe to call concurrently with the capture thread, see
+   * GetLatestFrameset().
    */
   std::shared_ptr<const RawImageData> GetLatestImage(const ImageType type,
                                                      uint64_t* timestamp) const;
 
+  /**
+   * Returns the latest images of all types with one atomic shared_ptr load.
+   * Prefer this over multiple GetLatestImage() calls when the images have to
+   * come from the same capture cycle. At most waits for a concurrent
+   * UpdateImages() to swap the pointer, never for it to build the frameset.
+   * Never returns nullptr.
+   */
+  std::shared_ptr<const ImageFrameset> GetLatestFrameset() const {
+    return std::atomic_load(&frameset_);
+  }
+
+  /**
+   * Sets the number of past images kept per enabled ImageType, for
+   * GetImageNearest() and GetImagesInRange(). Takes effect at the next
+   * Start(), which preallocates the history. Defaults to 0 (disabled).
+   */
+  void set_history_depth(int depth) { history_depth_ = depth; }
+  int get_history_depth() const { return history_depth_; }
+
+  /**
+   * Reduces DEPTH images by @p factor in both dimensions with @p method (see
+   * DecimateDepth()) as they arrive, before anything else sees them. The
+   * DEPTH intrinsics are decimated to match while started, so registration,
+   * point clouds and the published intrinsics all work at the lower
+   * resolution. Takes effect at the next Start(). Defaults to 1 (disabled).
+   * @throws std::runtime_error if @p factor < 1.
+   */
+  void set_depth_decimation(int factor, DecimationMethod method);
+  int get_depth_decimation_factor() const { return depth_decimation_factor_; }
+  DecimationMethod get_depth_decimation_method() const {
+    return depth_decimation_method_;
+  }
+
+  /**
+   * Returns the image of @p type in the history whose timestamp is closest
+   * to @p timestamp, and sets @p image_timestamp to its timestamp. Returns
+   * nullptr if the history is empty.
+   */
+  std::shared_ptr<const RawImageData> GetImageNearest(
+      const ImageType type, uint64_t timestamp,
+      uint64_t* image_timestamp) const;
+
+  /**
+   * Returns the images of @p type in the history with timestamps in
+   * [@p begin, @p end], oldest first.
+   */
+  std::vector<ImageHistory::Entry> GetImagesInRange(const ImageType type,
+                                                    uint64_t begin,
+                                                    uint64_t end) const {
+    return histories_.at(static_cast<int>(type)).GetInRange(begin, end);
+  }
+
+  /**
+   * Returns the number of images of @p type received since Start(). This is
+   * what WaitForNewFrame() compares against.
+   */
+  uint64_t get_image_sequence(const ImageType type) const {
+    return slots_.at(static_cast<int>(type))
+        .sequence.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Blocks until an image of @p type with a sequence number past @p last_seen
+   * arrives, or @p timeout expires.
+   * @return the latest sequence number of @p type, which is @p last_seen if
+   * the wait timed out.
+   */
+  uint64_t WaitForNewFrame(const ImageType type, uint64_t last_seen,
+                           std::chrono::microseconds timeout) const;
+
+  /**
+   * Returns a file descriptor (an eventfd) that becomes readable whenever new
+   * images arrive, for waiting on several sensors and other event sources
+   * with poll(2). It stays readable until ClearNewFrameFd() is called. Owned
+   * by this sensor.
+   */
+  int new_frame_fd() const { return new_frame_fd_; }
+
+  /**
+   * Resets new_frame_fd() to non readable.
+   */
+  void ClearNewFrameFd() const;
+
   const std::vector<ImageType>& get_supported_image_types() const {
     return supported_types_;
   }
@@ -60,8 +213,24 @@ class RGBDSensor {
    * Returns true if @p type has been started by by Start().
    */
   virtual bool is_enabled(const ImageType type) const {
-    std::unique_lock<std::mutex> lock(data_lock_);
-    return images_.count(type);
+    return slots_.at(static_cast<int>(type))
+        .enabled.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Returns the number of scalars per pixel of the images of @p type: 3 for
+   * color (RGB, also when captured as YUYV), 1 otherwise.
+   */
+  int get_image_channels(const ImageType type) const {
+    return is_color_image(type) ? 3 : 1;
+  }
+
+  /**
+   * Returns the number of bytes per scalar of the images of @p type: 2 for
+   * depth, 1 for color and IR by default.
+   */
+  virtual int get_image_scalar_size(const ImageType type) const {
+    return is_depth_image(type) ? 2 : 1;
   }
 
   /**
@@ -84,8 +253,17 @@ class RGBDSensor {
   void set_intrinsics(ImageType type, const Intrinsics& intrinsics) {
     std::unique_lock<std::mutex> lock(params_lock_);
     intrinsics_[type] = intrinsics;
+    ray_tables_.erase(type);
+    calibration_generation_++;
   }
 
+  /**
+   * Returns the back projection rays for the intrinsics of @p type. The table
+   * is built on first use and cached until set_intrinsics() changes them.
+   * @throws std::runtime_error if there are no intrinsics for @p type.
+   */
+  std::shared_ptr<const RayTable> get_ray_table(ImageType type) const;
+
   bool has_extrinsics(ImageType from, ImageType to) const {
     std::unique_lock<std::mutex> lock(params_lock_);
     return extrinsics_.count(std::pair<ImageType, ImageType>(from, to)) > 0;
@@ -111,8 +289,40 @@ class RGBDSensor {
     extrinsics_[std::pair<ImageType, ImageType>(from, to)] = extrinsics;
     extrinsics_[std::pair<ImageType, ImageType>(to, from)] =
         extrinsics.inverse();
+    calibration_generation_++;
   }
 
+  /**
+   * Returns a counter that every set_intrinsics() and set_extrinsics() call
+   * increments, so that results derived from the calibration can tell when
+   * they are stale.
+   */
+  uint64_t get_calibration_generation() const {
+    std::unique_lock<std::mutex> lock(params_lock_);
+    return calibration_generation_;
+  }
+
+  /**
+   * Returns the image of @p type registered in software from the DEPTH and
+   * RGB images of @p frameset (see DoRegisterDepthToColor() and
+   * DoRegisterColorToDepth()), or nullptr if @p frameset lacks either.
+   * Derived images are computed on first request and memoized on the source
+   * image timestamps and the calibration generation, so all consumers of the
+   * same image pair share one computation. Concurrent requests for an image
+   * that is being computed wait for it.
+   * @throws std::runtime_error if @p type is neither
+   * ImageType::RECT_RGB_ALIGNED_DEPTH nor ImageType::DEPTH_ALIGNED_RGB.
+   */
+  std::shared_ptr<const RawImageData> GetDerivedImage(
+      ImageType type, const ImageFrameset& frameset) const;
+
+  /**
+   * Returns the color pixel of each depth pixel of @p frameset (see
+   * DoComputeColorUvMap()), memoized the same way as GetDerivedImage().
+   */
+  std::shared_ptr<const RawImageData> GetColorUvMap(
+      const ImageFrameset& frameset) const;
+
   /// @return a string identifying the camera model (e.g. "realsense_d400").
   virtual std::string camera_model() const = 0;
 
@@ -142,20 +352,125 @@ class RGBDSensor {
   virtual void DoStop() = 0;
 
   /**
-   * This function adds all entries from @p images to images_.
+   * This function publishes all entries from @p images as the latest images
+   * in a new frameset, and wakes up WaitForNewFrame() and new_frame_fd()
+   * waiters. Images of types missing from @p images carry over from the
+   * previous frameset. Readers only wait for the final pointer swap, if at
+   * all. DEPTH images are decimated first, see set_depth_decimation(). RGB
+   * images with 2 channels are YUYV, and become ImageFrameset::yuyv_color.
+   * They are converted right away only if the RGB history is enabled, and
+   * then before other writers are locked out.
    */
   void UpdateImages(
       const std::map<const ImageType, TimeStampedImage>& images);
 
+  /**
+   * Returns an uninitialized image for @p type, backed by a recycled 64 byte
+   * aligned buffer from a pool owned by this sensor. Intended to be filled by
+   * the capture thread before it is passed to UpdateImages().
+   */
+  std::shared_ptr<RawImageData> MakePooledImage(ImageType type, int rows,
+                                                int cols, int channels,
+                                                int element_size);
+
  private:
+  // Publishes @p images as they are, see UpdateImages().
+  void PublishImages(
+      const std::map<const ImageType, TimeStampedImage>& images);
+
+  // Returns @p depth decimated with the settings latched by Start().
+  std::shared_ptr<const RawImageData> DecimateDepthImage(
+      const RawImageData& depth);
+
+  // Puts back the DEPTH intrinsics replaced by Start(), if any.
+  void RestoreDepthIntrinsics();
+
   const std::vector<ImageType> supported_types_;
 
   mutable std::mutex params_lock_;
   std::map<ImageType, Intrinsics> intrinsics_;
+  mutable std::map<ImageType, std::shared_ptr<const RayTable>> ray_tables_;
   std::map<std::pair<ImageType, ImageType>, Eigen::Isometry3f> extrinsics_;
+  uint64_t calibration_generation_{0};
+
+  // Calibration used to register DEPTH and RGB, read under one lock.
+  struct RegistrationCalibration {
+    Intrinsics color_intrinsics;
+    std::shared_ptr<const RayTable> depth_rays;
+    Eigen::Isometry3f X_rgb_depth;
+    uint64_t generation{0};
+  };
 
-  mutable std::mutex data_lock_;
-  std::map<const ImageType, TimeStampedImage> images_;
+  enum class DerivedKind { kAlignedDepth, kAlignedColor, kColorUvMap };
+
+  struct DerivedImageKey {
+    DerivedKind kind;
+    uint64_t depth_timestamp;
+    uint64_t color_timestamp;
+    uint64_t calibration_generation;
+
+    bool operator==(const DerivedImageKey& other) const {
+      return kind == other.kind && depth_timestamp == other.depth_timestamp &&
+             color_timestamp == other.color_timestamp &&
+             calibration_generation == other.calibration_generation;
+    }
+  };
+
+  typedef std::shared_future<std::shared_ptr<const RawImageData>>
+      DerivedImageFuture;
+
+  // Requires params_lock_.
+  std::shared_ptr<const RayTable> GetRayTableLocked(ImageType type) const;
+
+  RegistrationCalibration GetRegistrationCalibration() const;
+
+  std::shared_ptr<const RawImageData> GetDerived(
+      DerivedKind kind, const ImageFrameset& frameset,
+      const RegistrationCalibration& calibration) const;
+
+  // The state of one ImageType. `sequence` counts the updates.
+  struct ImageSlot {
+    std::atomic<bool> enabled{false};
+    std::atomic<uint64_t> sequence{0};
+  };
+
+  std::array<ImageSlot, kNumImageTypes> slots_;
+
+  // Only accessed through std::atomic_load / std::atomic_store, so that
+  // readers only contend with writers for the pointer copy. These are not
+  // lock free: libstdc++ guards them with a pool of internal locks, held for
+  // the copy only. update_lock_ serializes writers.
+  std::shared_ptr<const ImageFrameset> frameset_{
+      std::make_shared<const ImageFrameset>()};
+  std::mutex update_lock_;
+
+  std::atomic<int> history_depth_{0};
+  std::array<ImageHistory, kNumImageTypes> histories_;
+
+  // Only used for WaitForNewFrame(), never held while touching slots_.
+  mutable std::mutex new_frame_lock_;
+  mutable std::condition_variable new_frame_cv_;
+  int new_frame_fd_{-1};
+
+  std::mutex pools_lock_;
+  std::map<ImageType, std::shared_ptr<ImageBufferPool>> pools_;
+  std::shared_ptr<ImageBufferPool> decimation_pool_;
+
+  std::atomic<int> depth_decimation_factor_{1};
+  std::atomic<DecimationMethod> depth_decimation_method_{
+      DecimationMethod::STRIDE};
+  // The decimation applied by UpdateImages() since Start(), and the DEPTH
+  // intrinsics it replaced (under params_lock_).
+  std::atomic<int> active_decimation_factor_{1};
+  std::atomic<DecimationMethod> active_decimation_method_{
+      DecimationMethod::STRIDE};
+  std::unique_ptr<Intrinsics> undecimated_depth_intrinsics_;
+
+  // The most recently requested derived images, oldest first. Entries are
+  // added before they are computed, so that concurrent requests find them.
+  mutable std::mutex derived_lock_;
+  mutable std::deque<std::pair<DerivedImageKey, DerivedImageFuture>>
+      derived_images_;
 };
 
 /**
@@ -170,4 +485,36 @@ RawImageData DoRegisterDepthToColor(const Intrinsics& color_intrinsics,
                                     const RawImageData& color,
                                     const RawImageData& depth,
                                     ImageType depth_type);
+
+/**
+ * Same as above, but back projects depth pixels with the precomputed
+ * @p depth_rays (e.g. from RGBDSensor::get_ray_table()) instead of
+ * undistorting every pixel.
+ */
+RawImageData DoRegisterDepthToColor(const Intrinsics& color_intrinsics,
+                                    const RayTable& depth_rays,
+                                    const Eigen::Isometry3f& X_rgb_depth,
+                                    const RawImageData& color,
+                                    const RawImageData& depth,
+                                    ImageType depth_type);
+
+/**
+ * Returns where each pixel of @p depth lands in the color image: a depth
+ * sized image with 2 float channels, the (u, v) color pixel coordinates.
+ * Pixels without depth, or that land behind the color camera, are set to -1.
+ * The map is what DoRegisterColorToDepth() samples with, and can be reused by
+ * anything else that needs to color depth pixels.
+ */
+RawImageData DoComputeColorUvMap(const Intrinsics& color_intrinsics,
+                                 const RayTable& depth_rays,
+                                 const Eigen::Isometry3f& X_rgb_depth,
+                                 const RawImageData& depth);
+
+/**
+ * Return a depth-aligned color image in the depth camera frame, by sampling
+ * the nearest pixel of @p color at each entry of @p uv_map (see
+ * DoComputeColorUvMap()). Pixels that do not land in @p color are black.
+ */
+RawImageData DoRegisterColorToDepth(const RawImageData& color,
+                                    const RawImageData& uv_map);
 }  // namespace rs2_lcm
@@ -0,0 +1,169 @@
+#include "rgbd_sensor/rvl_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace rs2_lcm {
+namespace {
+
+// Writes nibbles into 32 bit words, most significant first.
+class NibbleWriter {
+ public:
+  explicit NibbleWriter(uint8_t* out) : out_(out) {}
+
+  void WriteVarint(uint32_t value) {
+    do {
+      uint32_t nibble = value & 0x7;
+      value >>= 3;
+      if (value) nibble |= 0x8;
+      word_ = (word_ << 4) | nibble;
+      if (++nibbles_ == 8) Flush();
+    } while (value);
+  }
+
+  // Pads and writes the last partial word. Returns the end of the output.
+  uint8_t* Finish() {
+    if (nibbles_ > 0) {
+      word_ <<= 4 * (8 - nibbles_);
+      Flush();
+    }
+    return out_;
+  }
+
+ private:
+  void Flush() {
+    memcpy(out_, &word_, sizeof(word_));
+    out_ += sizeof(word_);
+    word_ = 0;
+    nibbles_ = 0;
+  }
+
+  uint8_t* out_;
+  uint32_t word_{0};
+  int nibbles_{0};
+};
+
+// Reads what NibbleWriter wrote, checking for the end of the input.
+class NibbleReader {
+ public:
+  NibbleReader(const uint8_t* in, size_t size) : in_(in), end_(in + size) {}
+
+  uint32_t ReadVarint() {
+    uint32_t value = 0;
+    int shift = 0;
+    uint32_t nibble;
+    do {
+      if (nibbles_ == 0) {
+        if (end_ - in_ < static_cast<ptrdiff_t>(sizeof(word_))) {
+          throw std::runtime_error("Truncated RVL data");
+        }
+        memcpy(&word_, in_, sizeof(word_));
+        in_ += sizeof(word_);
+        nibbles_ = 8;
+      }
+      nibble = word_ >> 28;
+      word_ <<= 4;
+      nibbles_--;
+      if (shift > 30) throw std::runtime_error("Invalid RVL data");
+      value |= (nibble & 0x7) << shift;
+      shift += 3;
+    } while (nibble & 0x8);
+    return value;
+  }
+
+ private:
+  const uint8_t* in_;
+  const uint8_t* const end_;
+  uint32_t word_{0};
+  int nibbles_{0};
+};
+
+// Returns the number of pixels from @p begin up to @p end that are zero if
+// @p zeros, or non zero otherwise.
+int CountRun(const uint16_t* begin, const uint16_t* end, bool zeros) {
+  const uint16_t* p = begin;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  // One bit per byte, so two per pixel, of the pixels that end the run.
+  const int invert = zeros ? 0xffff : 0;
+  for (; end - p >= 8; p += 8) {
+    const __m128i pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const int stops =
+        _mm_movemask_epi8(_mm_cmpeq_epi16(pixels, zero)) ^ invert;
+    if (stops) return (p - begin) + __builtin_ctz(stops) / 2;
+  }
+#endif
+  while (p < end && (*p == 0) == zeros) p++;
+  return p - begin;
+}
+
+}  // namespace
+
+size_t RvlMaxEncodedSize(int num_pixels) {
+  // A run of z zeros and k non zeros costs at most max(z, 1) + k nibbles for
+  // the lengths, plus 6 per non zero (an 18 bit zigzag difference). Only the
+  // first run can lack zeros and only the last run can lack non zeros, so
+  // that is at most 7 nibbles per pixel and a few for the first and last run.
+  const size_t nibbles = 7 * static_cast<size_t>(num_pixels) + 24;
+  return (nibbles + 7) / 8 * sizeof(uint32_t);
+}
+
+void RvlEncode(const uint16_t* depth, int num_pixels,
+               std::vector<uint8_t>* encoded) {
+  encoded->resize(RvlMaxEncodedSize(num_pixels));
+  NibbleWriter writer(encoded->data());
+  const uint16_t* p = depth;
+  const uint16_t* const end = depth + num_pixels;
+  int previous = 0;
+  while (p < end) {
+    const int num_zeros = CountRun(p, end, true);
+    p += num_zeros;
+    const int num_non_zeros = CountRun(p, end, false);
+    writer.WriteVarint(num_zeros);
+    writer.WriteVarint(num_non_zeros);
+    for (const uint16_t* run_end = p + num_non_zeros; p < run_end; p++) {
+      const int delta = *p - previous;
+      // Zigzag in unsigned arithmetic, as shifting a negative int left is
+      // undefined.
+      writer.WriteVarint((static_cast<uint32_t>(delta) << 1) ^
+                         static_cast<uint32_t>(delta >> 31));
+      previous = *p;
+    }
+  }
+  encoded->resize(writer.Finish() - encoded->data());
+}
+
+void RvlDecode(const uint8_t* encoded, size_t size, int num_pixels,
+               uint16_t* depth) {
+  NibbleReader reader(encoded, size);
+  uint16_t* p = depth;
+  uint16_t* const end = depth + num_pixels;
+  int previous = 0;
+  while (p < end) {
+    const uint32_t num_zeros = reader.ReadVarint();
+    if (num_zeros > static_cast<uint32_t>(end - p)) {
+      throw std::runtime_error("Invalid RVL data");
+    }
+    std::fill(p, p + num_zeros, 0);
+    p += num_zeros;
+    const uint32_t num_non_zeros = reader.ReadVarint();
+    if (num_non_zeros > static_cast<uint32_t>(end - p)) {
+      throw std::runtime_error("Invalid RVL data");
+    }
+    for (uint16_t* run_end = p + num_non_zeros; p < run_end; p++) {
+      const uint32_t zigzag = reader.ReadVarint();
+      const int delta =
+          static_cast<int>(zigzag >> 1) ^ -static_cast<int>(zigzag & 1);
+      previous += delta;
+      *p = static_cast<uint16_t>(previous);
+    }
+  }
+}
+
+}  // namespace rs2_lcm
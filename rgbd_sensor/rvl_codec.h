@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rs2_lcm {
+
+/**
+ * lcmt_image::compression_method of RVL encoded depth images. Drake's own
+ * methods stop at 3, this is picked well clear of them.
+ */
+constexpr int8_t kCompressionMethodRvl = 100;
+
+/**
+ * Lossless depth compression after Wilson, "Fast Lossless Depth Image
+ * Compression" (RVL). The pixels are scanned in row major order as
+ * alternating runs of zeros (no depth) and non zeros. Each run length, and
+ * the zigzag encoded difference of each non zero pixel to the previous non
+ * zero pixel, is written with a variable length code of 4 bit nibbles (3
+ * data bits and a continuation bit), most significant nibble first in 32 bit
+ * little endian words.
+ *
+ * The zero / non zero runs are found 8 pixels at a time with SSE2 when it is
+ * available at compile time, with a scalar fallback.
+ */
+
+/**
+ * Returns an upper bound on the size of RvlEncode()'s output for
+ * @p num_pixels pixels.
+ */
+size_t RvlMaxEncodedSize(int num_pixels);
+
+/**
+ * Encodes the @p num_pixels pixels of @p depth into @p encoded, which is
+ * resized to fit. The capacity of @p encoded is reused.
+ */
+void RvlEncode(const uint16_t* depth, int num_pixels,
+               std::vector<uint8_t>* encoded);
+
+/**
+ * Decodes the @p size bytes of @p encoded into the @p num_pixels pixels of
+ * @p depth.
+ * @throws std::runtime_error if @p encoded is truncated, or does not hold
+ * exactly @p num_pixels pixels.
+ */
+void RvlDecode(const uint8_t* encoded, size_t size, int num_pixels,
+               uint16_t* depth);
+
+}  // namespace rs2_lcm
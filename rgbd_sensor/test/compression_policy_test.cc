@@ -0,0 +1,76 @@
+#include "rgbd_sensor/compression_policy.h"
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+
+GTEST_TEST(CompressionPolicyTest, Defaults) {
+  const CompressionPolicy policy;
+  EXPECT_EQ(policy.Get("any", ImageType::RGB).codec, "jpeg");
+  EXPECT_EQ(policy.Get("any", ImageType::DEPTH_ALIGNED_RGB).codec, "jpeg");
+  EXPECT_EQ(policy.Get("any", ImageType::DEPTH).codec, "zlib");
+  EXPECT_EQ(policy.Get("any", ImageType::RECT_RGB_ALIGNED_DEPTH).codec,
+            "zlib");
+  EXPECT_EQ(policy.Get("any", ImageType::IR).codec, "png");
+  EXPECT_EQ(policy.Get("any", ImageType::IR).level, CodecSettings::kDefault);
+}
+
+GTEST_TEST(CompressionPolicyTest, ParseSpec) {
+  CompressionPolicy policy;
+  policy.ParseSpec("DEPTH=rvl,INFRARED=zstd:level=1:threads=2:shuffle=0,"
+                   "1234/RGB=jpeg:quality=80");
+  EXPECT_EQ(policy.Get("any", ImageType::DEPTH).codec, "rvl");
+  EXPECT_EQ(policy.Get("any", ImageType::IR).codec, "zstd");
+  EXPECT_EQ(policy.Get("any", ImageType::IR).level, 1);
+  EXPECT_EQ(policy.Get("any", ImageType::IR).threads, 2);
+  EXPECT_EQ(policy.Get("any", ImageType::IR).shuffle, 0);
+  EXPECT_EQ(policy.Get("any", ImageType::RGB).quality,
+            CodecSettings::kDefault);
+  EXPECT_EQ(policy.Get("1234", ImageType::RGB).quality, 80);
+  // Camera specific settings only replace their own stream.
+  EXPECT_EQ(policy.Get("1234", ImageType::DEPTH).codec, "rvl");
+
+  policy.ParseSpec("");
+  EXPECT_EQ(policy.Get("any", ImageType::DEPTH).codec, "rvl");
+
+  EXPECT_THROW(policy.ParseSpec("DEPTH"), std::runtime_error);
+  EXPECT_THROW(policy.ParseSpec("DEPTH=bogus"), std::runtime_error);
+  EXPECT_THROW(policy.ParseSpec("BOGUS=zlib"), std::runtime_error);
+  EXPECT_THROW(policy.ParseSpec("DEPTH=zlib:speed=1"), std::runtime_error);
+  EXPECT_THROW(policy.ParseSpec("DEPTH=zlib:level=fast"), std::runtime_error);
+  EXPECT_THROW(policy.ParseSpec("DEPTH=zlib:level=1abc"), std::runtime_error);
+  EXPECT_THROW(policy.ParseSpec("DEPTH=zlib:level="), std::runtime_error);
+  EXPECT_THROW(policy.ParseSpec("DEPTH=zlib:level=99999999999"),
+               std::runtime_error);
+}
+
+GTEST_TEST(CompressionPolicyTest, LoadJson) {
+  char path[] = "/tmp/compression_policy_testXXXXXX";
+  const int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  std::ofstream(path) << R"({
+    "default": {"DEPTH": {"codec": "rvl"}, "INFRARED": {"level": 5}},
+    "cameras": {"1234": {"RGB": {"quality": 70}}}
+  })";
+
+  CompressionPolicy policy;
+  policy.LoadJson(path);
+  EXPECT_EQ(policy.Get("any", ImageType::DEPTH).codec, "rvl");
+  EXPECT_EQ(policy.Get("any", ImageType::IR).codec, "png");
+  EXPECT_EQ(policy.Get("any", ImageType::IR).level, 5);
+  EXPECT_EQ(policy.Get("1234", ImageType::RGB).codec, "jpeg");
+  EXPECT_EQ(policy.Get("1234", ImageType::RGB).quality, 70);
+
+  std::ofstream(path) << "{";
+  EXPECT_THROW(policy.LoadJson(path), std::runtime_error);
+  unlink(path);
+}
+
+}  // namespace rs2_lcm
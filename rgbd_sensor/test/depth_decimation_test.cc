@@ -0,0 +1,76 @@
+#include "rgbd_sensor/depth_decimation.h"
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+
+GTEST_TEST(DepthDecimationTest, DecimateDepth) {
+  // A 5x7 image decimated by 2 drops the last row and column.
+  RawImageData depth(5, 7, 1, sizeof(uint16_t));
+  auto view = depth.mutable_slice<uint16_t>();
+  for (int v = 0; v < 5; v++) {
+    for (int u = 0; u < 7; u++) view(v, u) = 100 + 10 * v + u;
+  }
+  // A block with one invalid pixel, and one with none valid.
+  view(0, 2) = 0;
+  view(2, 4) = view(2, 5) = view(3, 4) = view(3, 5) = 0;
+
+  const RawImageData stride =
+      DecimateDepth(depth, 2, DecimationMethod::STRIDE);
+  ASSERT_EQ(stride.rows(), 2);
+  ASSERT_EQ(stride.cols(), 3);
+  EXPECT_EQ(stride.slice<uint16_t>()(0, 0), 100);
+  EXPECT_EQ(stride.slice<uint16_t>()(0, 1), 0);
+  EXPECT_EQ(stride.slice<uint16_t>()(1, 2), 0);
+  EXPECT_EQ(stride.slice<uint16_t>()(1, 1), 122);
+
+  const RawImageData min = DecimateDepth(depth, 2, DecimationMethod::MIN);
+  EXPECT_EQ(min.slice<uint16_t>()(0, 0), 100);
+  EXPECT_EQ(min.slice<uint16_t>()(0, 1), 103);
+  EXPECT_EQ(min.slice<uint16_t>()(1, 2), 0);
+
+  const RawImageData median =
+      DecimateDepth(depth, 2, DecimationMethod::MEDIAN);
+  // Of {100, 101, 110, 111}, the upper median.
+  EXPECT_EQ(median.slice<uint16_t>()(0, 0), 110);
+  // Of {103, 112, 113}.
+  EXPECT_EQ(median.slice<uint16_t>()(0, 1), 112);
+  EXPECT_EQ(median.slice<uint16_t>()(1, 2), 0);
+
+  const RawImageData same = DecimateDepth(depth, 1, DecimationMethod::MEDIAN);
+  EXPECT_EQ(same.slice<uint16_t>(), depth.slice<uint16_t>());
+
+  EXPECT_THROW(DecimateDepth(depth, 0, DecimationMethod::STRIDE),
+               std::runtime_error);
+}
+
+GTEST_TEST(DepthDecimationTest, DecimateIntrinsics) {
+  const Intrinsics intrinsics(64, 48, 60, 61, 31.5, 24.2);
+  for (auto method : {DecimationMethod::STRIDE, DecimationMethod::MEDIAN}) {
+    const Intrinsics decimated = DecimateIntrinsics(intrinsics, 4, method);
+    EXPECT_EQ(decimated.width(), 16);
+    EXPECT_EQ(decimated.height(), 12);
+
+    // Decimated pixels see along the ray of the pixel they sample.
+    const float offset = method == DecimationMethod::STRIDE ? 0 : 1.5;
+    for (int v = 0; v < decimated.height(); v++) {
+      for (int u = 0; u < decimated.width(); u++) {
+        const Eigen::Vector3f expected = intrinsics.BackProject(
+            Eigen::Vector2f(4 * u + offset, 4 * v + offset), 1);
+        const Eigen::Vector3f ray =
+            decimated.BackProject(Eigen::Vector2f(u, v), 1);
+        EXPECT_LT((ray - expected).norm(), 1e-5);
+      }
+    }
+  }
+}
+
+GTEST_TEST(DepthDecimationTest, MethodNames) {
+  for (auto method : {DecimationMethod::STRIDE, DecimationMethod::MEDIAN,
+                      DecimationMethod::MIN}) {
+    EXPECT_EQ(StringToDecimationMethod(to_string(method)), method);
+  }
+  EXPECT_THROW(StringToDecimationMethod("mean"), std::runtime_error);
+}
+
+}  // namespace rs2_lcm
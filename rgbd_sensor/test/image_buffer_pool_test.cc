@@ -0,0 +1,51 @@
+#include "rgbd_sensor/image_buffer_pool.h"
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+
+GTEST_TEST(ImageBufferPoolTest, Recycle) {
+  const int kRows = 3;
+  const int kCols = 5;
+  auto pool = ImageBufferPool::Make(kRows * kCols * sizeof(uint16_t), 1);
+
+  auto image = pool->MakeImage(kRows, kCols, 1, sizeof(uint16_t));
+  EXPECT_EQ(image->rows(), kRows);
+  EXPECT_EQ(image->cols(), kCols);
+  EXPECT_EQ(image->scalar_size(), sizeof(uint16_t));
+  EXPECT_EQ(
+      reinterpret_cast<uintptr_t>(image->data()) % ImageBufferPool::kAlignment,
+      0);
+  image->at<uint16_t>(2, 4) = 42;
+  const uint8_t* data = image->data();
+
+  // Dropping the last reference returns the buffer to the pool, and the next
+  // image reuses it.
+  EXPECT_EQ(pool->num_free_buffers(), 0);
+  image.reset();
+  EXPECT_EQ(pool->num_free_buffers(), 1);
+  image = pool->MakeImage(kRows, kCols, 1, sizeof(uint16_t));
+  EXPECT_EQ(image->data(), data);
+  EXPECT_EQ(pool->num_free_buffers(), 0);
+
+  // Idle buffers beyond the limit are freed.
+  auto other = pool->Acquire();
+  image.reset();
+  other.reset();
+  EXPECT_EQ(pool->num_free_buffers(), 1);
+
+  // Images can outlive the pool.
+  image = pool->MakeImage(kRows, kCols, 1, sizeof(uint16_t));
+  pool.reset();
+  EXPECT_EQ(image->at<uint16_t>(2, 4), 42);
+  image.reset();
+}
+
+GTEST_TEST(ImageBufferPoolTest, TooLarge) {
+  auto pool = ImageBufferPool::Make(16);
+  EXPECT_THROW(pool->MakeImage(4, 4, 1, 2), std::runtime_error);
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,188 @@
+#include "rgbd_sensor/image_codec.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+namespace {
+
+RawImageData MakeImage(int channels, int scalar_size) {
+  RawImageData image(12, 16, channels, channels * scalar_size);
+  // Smooth, so that lossy codecs stay close.
+  for (int i = 0; i < image.size(); i++) {
+    image.data()[i] = scalar_size == 2 && i % 2 ? 3 : 100 + (i / 64) % 8;
+  }
+  return image;
+}
+
+// Encodes and decodes @p image with @p name, and returns the largest error.
+int RoundTrip(const std::string& name, const RawImageData& image,
+              const CodecSettings& settings = {}) {
+  auto codec = GetImageCodec(name);
+  std::vector<uint8_t> data;
+  codec->Encode(image, settings, &data);
+  RawImageData decoded(image.rows(), image.cols(), image.channels(),
+                       image.channels() * image.scalar_size());
+  codec->Decode(data.data(), data.size(), &decoded);
+  int error = 0;
+  for (int i = 0; i < image.size(); i++) {
+    error = std::max(error, std::abs(image.data()[i] - decoded.data()[i]));
+  }
+  return error;
+}
+
+// Inverts the image bytes.
+class TestCodec : public ImageCodec {
+ public:
+  int8_t compression_method() const override { return 120; }
+  bool Supports(int, int) const override { return true; }
+  void Encode(const RawImageData& image, const CodecSettings&,
+              std::vector<uint8_t>* data) const override {
+    data->resize(image.size());
+    for (int i = 0; i < image.size(); i++) (*data)[i] = ~image.data()[i];
+  }
+  void Decode(const uint8_t* data, size_t size,
+              RawImageData* image) const override {
+    for (size_t i = 0; i < size; i++) image->data()[i] = ~data[i];
+  }
+};
+
+}  // namespace
+
+GTEST_TEST(ImageCodecTest, LosslessRoundTrip) {
+  const RawImageData color = MakeImage(3, 1);
+  const RawImageData depth = MakeImage(1, 2);
+  const RawImageData ir = MakeImage(1, 1);
+  for (const std::string name : {"raw", "zlib", "png", "lz4", "zstd"}) {
+    EXPECT_EQ(RoundTrip(name, color), 0) << name;
+    EXPECT_EQ(RoundTrip(name, depth), 0) << name;
+    EXPECT_EQ(RoundTrip(name, ir), 0) << name;
+  }
+  EXPECT_EQ(RoundTrip("rvl", depth), 0);
+  CodecSettings settings;
+  settings.level = 9;
+  EXPECT_EQ(RoundTrip("zlib", depth, settings), 0);
+}
+
+GTEST_TEST(ImageCodecTest, ByteStreamSettings) {
+  const RawImageData depth = MakeImage(1, 2);
+  for (const std::string name : {"lz4", "zstd"}) {
+    for (int level : {CodecSettings::kDefault, -20, 1, 9}) {
+      for (int shuffle : {CodecSettings::kDefault, 0, 1}) {
+        CodecSettings settings;
+        settings.level = level;
+        settings.shuffle = shuffle;
+        settings.threads = 2;
+        EXPECT_EQ(RoundTrip(name, depth, settings), 0) << name;
+      }
+    }
+
+    // Shuffling groups the high bytes of depth, which are all the same.
+    auto codec = GetImageCodec(name);
+    std::vector<uint8_t> shuffled, unshuffled;
+    CodecSettings settings;
+    codec->Encode(depth, settings, &shuffled);
+    settings.shuffle = 0;
+    codec->Encode(depth, settings, &unshuffled);
+    EXPECT_NE(shuffled, unshuffled);
+
+    // Negative levels trade ratio for speed, which shows on a full size
+    // image with some structure.
+    RawImageData large(240, 320, 1, 2);
+    for (int v = 0; v < large.rows(); v++) {
+      for (int u = 0; u < large.cols(); u++) {
+        large.at<uint16_t>(v, u) = 1000 + (u * u + 3 * v) % 97;
+      }
+    }
+    std::vector<uint8_t> normal, fast;
+    settings = CodecSettings();
+    codec->Encode(large, settings, &normal);
+    settings.level = -50;
+    codec->Encode(large, settings, &fast);
+    EXPECT_GT(fast.size(), normal.size()) << name;
+
+    // Truncated and corrupt data.
+    RawImageData decoded(depth.rows(), depth.cols(), 1, 2);
+    EXPECT_THROW(codec->Decode(shuffled.data(), 0, &decoded),
+                 std::runtime_error);
+    EXPECT_THROW(codec->Decode(shuffled.data(), shuffled.size() / 2,
+                               &decoded),
+                 std::runtime_error);
+    shuffled[0] = 0xff;
+    EXPECT_THROW(codec->Decode(shuffled.data(), shuffled.size(), &decoded),
+                 std::runtime_error);
+  }
+}
+
+GTEST_TEST(ImageCodecTest, Jpeg) {
+  CodecSettings settings;
+  settings.quality = 95;
+  EXPECT_LE(RoundTrip("jpeg", MakeImage(3, 1), settings), 4);
+  EXPECT_LE(RoundTrip("jpeg", MakeImage(1, 1), settings), 4);
+  settings.subsampling = 444;
+  EXPECT_LE(RoundTrip("jpeg", MakeImage(3, 1), settings), 4);
+  settings.subsampling = 411;
+  std::vector<uint8_t> data;
+  EXPECT_THROW(GetImageCodec("jpeg")->Encode(MakeImage(3, 1), settings, &data),
+               std::runtime_error);
+}
+
+GTEST_TEST(ImageCodecTest, Yuyv) {
+  // Video range gray.
+  RawImageData yuyv(8, 16, 2, 2);
+  for (int i = 0; i < yuyv.size(); i++) yuyv.data()[i] = i % 2 ? 128 : 126;
+
+  std::vector<uint8_t> data;
+  CodecSettings settings;
+  EXPECT_FALSE(GetImageCodec("zlib")->EncodeYuyv(yuyv, settings, &data));
+  settings.subsampling = 444;
+  EXPECT_FALSE(GetImageCodec("jpeg")->EncodeYuyv(yuyv, settings, &data));
+
+  settings.subsampling = CodecSettings::kDefault;
+  ASSERT_TRUE(GetImageCodec("jpeg")->EncodeYuyv(yuyv, settings, &data));
+  RawImageData decoded(8, 16, 3, 3);
+  GetImageCodec("jpeg")->Decode(data.data(), data.size(), &decoded);
+  for (int i = 0; i < decoded.size(); i++) {
+    EXPECT_NEAR(decoded.data()[i], 128, 2);
+  }
+}
+
+GTEST_TEST(ImageCodecTest, Unsupported) {
+  std::vector<uint8_t> data;
+  EXPECT_THROW(GetImageCodec("jpeg")->Encode(MakeImage(1, 2), {}, &data),
+               std::runtime_error);
+  EXPECT_THROW(GetImageCodec("rvl")->Encode(MakeImage(3, 1), {}, &data),
+               std::runtime_error);
+  EXPECT_FALSE(GetImageCodec("rvl")->Supports(1, 1));
+
+  // Data that does not decode to the expected size.
+  RawImageData depth = MakeImage(1, 2);
+  GetImageCodec("zlib")->Encode(depth, {}, &data);
+  RawImageData wrong(2, 2, 1, 2);
+  EXPECT_THROW(GetImageCodec("zlib")->Decode(data.data(), data.size(), &wrong),
+               std::runtime_error);
+}
+
+GTEST_TEST(ImageCodecTest, Registry) {
+  EXPECT_THROW(GetImageCodec("bogus"), std::runtime_error);
+  EXPECT_THROW(GetImageCodecForMethod(120), std::runtime_error);
+  EXPECT_EQ(GetImageCodecForMethod(GetImageCodec("rvl")->compression_method()),
+            GetImageCodec("rvl"));
+  EXPECT_EQ(GetImageCodecForMethod(kCompressionMethodLz4),
+            GetImageCodec("lz4"));
+  EXPECT_EQ(GetImageCodecForMethod(kCompressionMethodZstd),
+            GetImageCodec("zstd"));
+
+  RegisterImageCodec("test", std::make_shared<TestCodec>());
+  EXPECT_EQ(GetImageCodecForMethod(120), GetImageCodec("test"));
+  EXPECT_EQ(RoundTrip("test", MakeImage(3, 1)), 0);
+  const std::vector<std::string> names = GetImageCodecNames();
+  EXPECT_NE(std::find(names.begin(), names.end(), "test"), names.end());
+}
+
+}  // namespace rs2_lcm
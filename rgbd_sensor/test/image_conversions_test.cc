@@ -0,0 +1,72 @@
+#include "rgbd_sensor/image_conversions.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+
+GTEST_TEST(ImageConversionsTest, WidenY8ToY16) {
+  // Odd width and padded source rows to exercise the scalar tails.
+  const int kWidth = 37;
+  const int kHeight = 5;
+  const int kStride = 48;
+
+  std::vector<uint8_t> src(kStride * kHeight);
+  for (size_t i = 0; i < src.size(); i++) src[i] = (i * 7) & 0xff;
+
+  std::vector<uint16_t> dst(kWidth * kHeight);
+  WidenY8ToY16(src.data(), kStride, kWidth, kHeight, dst.data());
+
+  for (int y = 0; y < kHeight; y++) {
+    for (int x = 0; x < kWidth; x++) {
+      EXPECT_EQ(dst[x + y * kWidth], src[x + y * kStride] * 256);
+    }
+  }
+}
+
+GTEST_TEST(ImageConversionsTest, YuyvToRgb) {
+  const int kWidth = 4;
+  const int kStride = 12;
+  // Video range black, white, and a pair sharing red chroma, with a padded
+  // second row.
+  const std::vector<uint8_t> src = {16,  128, 235, 128, 81, 90, 81, 240,
+                                    255, 255, 255, 255, 16, 128, 16, 128,
+                                    16,  128, 16,  128, 0,  0,  0,  0};
+  std::vector<uint8_t> dst(kWidth * 2 * 3);
+  YuyvToRgb(src.data(), kStride, kWidth, 2, dst.data());
+
+  const std::vector<uint8_t> expected_first_row = {0,   0,   0,  255, 255, 255,
+                                                   255, 0,   0,  255, 0,   0};
+  for (int i = 0; i < kWidth * 3; i++) {
+    EXPECT_NEAR(dst[i], expected_first_row[i], 1) << i;
+  }
+  for (int i = kWidth * 3; i < kWidth * 2 * 3; i++) EXPECT_EQ(dst[i], 0);
+}
+
+GTEST_TEST(ImageConversionsTest, ScaleDepth) {
+  const int kWidth = 37;
+  const int kHeight = 5;
+  const int kStride = 48 * sizeof(uint16_t);
+
+  std::vector<uint16_t> src(kStride / sizeof(uint16_t) * kHeight);
+  for (size_t i = 0; i < src.size(); i++) src[i] = (i * 1031) & 0xffff;
+  auto src_at = [&](int x, int y) {
+    return src[x + y * kStride / sizeof(uint16_t)];
+  };
+
+  std::vector<uint16_t> dst(kWidth * kHeight);
+  for (float scale : {1.f, 0.1f, 0.25f, 2.5f}) {
+    ScaleDepth(src.data(), kStride, kWidth, kHeight, scale, dst.data());
+    for (int y = 0; y < kHeight; y++) {
+      for (int x = 0; x < kWidth; x++) {
+        // Saturates instead of wrapping around.
+        const float expected = std::min(src_at(x, y) * scale, 65535.f);
+        EXPECT_EQ(dst[x + y * kWidth], static_cast<uint16_t>(expected));
+      }
+    }
+  }
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,72 @@
+#include "rgbd_sensor/image_history.h"
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+namespace {
+
+std::shared_ptr<const RawImageData> MakeImage() {
+  return RawImageData::MakeSharedRawImageData<uint16_t>(2, 2, 1);
+}
+
+}  // namespace
+
+GTEST_TEST(ImageHistoryTest, Nearest) {
+  ImageHistory history(3);
+  EXPECT_EQ(history.GetNearest(10).image, nullptr);
+
+  auto image_10 = MakeImage();
+  auto image_20 = MakeImage();
+  auto image_30 = MakeImage();
+  auto image_40 = MakeImage();
+  history.Push(10, image_10);
+  history.Push(20, image_20);
+  history.Push(30, image_30);
+  EXPECT_EQ(history.size(), 3);
+
+  EXPECT_EQ(history.GetNearest(0).image, image_10);
+  EXPECT_EQ(history.GetNearest(14).image, image_10);
+  EXPECT_EQ(history.GetNearest(15).image, image_10);
+  EXPECT_EQ(history.GetNearest(16).image, image_20);
+  EXPECT_EQ(history.GetNearest(100).image, image_30);
+
+  // The oldest image is evicted, and the ring wraps around.
+  history.Push(40, image_40);
+  EXPECT_EQ(history.size(), 3);
+  EXPECT_EQ(history.GetNearest(0).image, image_20);
+  EXPECT_EQ(history.GetNearest(36).image, image_40);
+  EXPECT_EQ(history.GetNearest(36).timestamp, 40);
+}
+
+GTEST_TEST(ImageHistoryTest, Range) {
+  ImageHistory history(4);
+  for (uint64_t t = 10; t <= 60; t += 10) history.Push(t, MakeImage());
+
+  auto range = history.GetInRange(25, 50);
+  ASSERT_EQ(range.size(), 3);
+  EXPECT_EQ(range[0].timestamp, 30);
+  EXPECT_EQ(range[1].timestamp, 40);
+  EXPECT_EQ(range[2].timestamp, 50);
+  EXPECT_TRUE(history.GetInRange(61, 100).empty());
+  EXPECT_EQ(history.GetInRange(0, 100).size(), 4);
+}
+
+GTEST_TEST(ImageHistoryTest, ClockReset) {
+  ImageHistory history(4);
+  history.Push(100, MakeImage());
+  history.Push(200, MakeImage());
+  history.Push(5, MakeImage());
+  EXPECT_EQ(history.size(), 1);
+  EXPECT_EQ(history.GetNearest(200).timestamp, 5);
+
+  history.Reset(2);
+  EXPECT_EQ(history.size(), 0);
+  EXPECT_EQ(history.capacity(), 2);
+
+  // A zero capacity history drops everything.
+  history.Reset(0);
+  history.Push(1, MakeImage());
+  EXPECT_EQ(history.size(), 0);
+}
+
+}  // namespace rs2_lcm
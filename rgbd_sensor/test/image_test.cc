@@ -72,4 +72,70 @@ GTEST_TEST(ImageTest, Test) {
   EXPECT_EQ(cv_val[0], 2 * kChannels + 2 * kCols * kChannels);
 }
 
+GTEST_TEST(ImageTest, ExternalBufferTest) {
+  const int kRows = 3;
+  const int kCols = 4;
+
+  auto buffer = std::make_shared<std::vector<uint16_t>>(kRows * kCols);
+  for (size_t i = 0; i < buffer->size(); i++) (*buffer)[i] = i;
+  std::weak_ptr<std::vector<uint16_t>> weak_buffer = buffer;
+
+  auto raw_img = RawImageData::WrapSharedRawImageData<uint16_t>(
+      kRows, kCols, 1, buffer, buffer->data());
+  const uint16_t* external_data = buffer->data();
+  buffer.reset();
+
+  // The image keeps the owner alive and does not copy its data.
+  EXPECT_FALSE(weak_buffer.expired());
+  EXPECT_EQ(reinterpret_cast<const uint16_t*>(raw_img->data()),
+            external_data);
+  EXPECT_EQ(raw_img->size(), kRows * kCols * sizeof(uint16_t));
+  for (int r = 0; r < kRows; r++) {
+    for (int c = 0; c < kCols; c++) {
+      EXPECT_EQ(raw_img->at<uint16_t>(r, c), c + r * kCols);
+    }
+  }
+
+  // Copies are deep.
+  RawImageData copy(*raw_img);
+  EXPECT_NE(copy.data(), raw_img->data());
+  EXPECT_EQ(copy.at<uint16_t>(2, 3), raw_img->at<uint16_t>(2, 3));
+
+  raw_img.reset();
+  EXPECT_TRUE(weak_buffer.expired());
+  EXPECT_EQ(copy.at<uint16_t>(2, 3), 2 * kCols + 3);
+}
+
+GTEST_TEST(ImageTest, UninitializedTest) {
+  RawImageData raw_img = RawImageData::MakeUninitialized(3, 4, 2, 4);
+  EXPECT_EQ(raw_img.rows(), 3);
+  EXPECT_EQ(raw_img.cols(), 4);
+  EXPECT_EQ(raw_img.channels(), 2);
+  EXPECT_EQ(raw_img.scalar_size(), 2);
+  EXPECT_EQ(raw_img.size(), 3 * 4 * 4);
+  raw_img.at<uint16_t>(2, 3, 1) = 7;
+  EXPECT_EQ(raw_img.at<uint16_t>(2, 3, 1), 7);
+
+  // Moves keep the buffer, copies are deep.
+  const uint8_t* data = raw_img.data();
+  RawImageData moved(std::move(raw_img));
+  EXPECT_EQ(moved.data(), data);
+  RawImageData copy(moved);
+  EXPECT_NE(copy.data(), data);
+  EXPECT_EQ(copy.at<uint16_t>(2, 3, 1), 7);
+}
+
+GTEST_TEST(ImageTest, CvImageViewTest) {
+  RawImageData raw_img(3, 4, 3, 3);
+  raw_img.at<uint8_t>(2, 1, 2) = 42;
+
+  // The view aliases the data, unlike MakeCvImage().
+  const cv::Mat view = raw_img.MakeCvImageView(CV_8UC3);
+  EXPECT_EQ(view.data, raw_img.data());
+  EXPECT_EQ(view.at<cv::Vec3b>(2, 1)[2], 42);
+  EXPECT_NE(raw_img.MakeCvImage(CV_8UC3).data, raw_img.data());
+
+  EXPECT_THROW(raw_img.MakeCvImageView(CV_16UC1), std::runtime_error);
+}
+
 }  // namespace rs2_lcm
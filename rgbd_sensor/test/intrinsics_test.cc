@@ -0,0 +1,125 @@
+#include "rgbd_sensor/intrinsics.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "rgbd_sensor/ray_table.h"
+
+namespace rs2_lcm {
+namespace {
+
+const std::array<float, 5> kCoeffs{0.1f, -0.05f, 0.001f, -0.002f, 0.01f};
+// FTHETA only uses the first coefficient, the field of view.
+const std::array<float, 5> kFthetaCoeffs{0.9f, 0.f, 0.f, 0.f, 0.f};
+
+const Intrinsics::DistortionModel kModels[] = {
+    Intrinsics::DistortionModel::NONE,
+    Intrinsics::DistortionModel::MODIFIED_BROWN_CONRADY,
+    Intrinsics::DistortionModel::INVERSE_BROWN_CONRADY,
+    Intrinsics::DistortionModel::FTHETA,
+    Intrinsics::DistortionModel::BROWN_CONRADY,
+};
+
+Intrinsics MakeIntrinsics(Intrinsics::DistortionModel model) {
+  return Intrinsics(64, 48, 60, 61, 31.5, 24.2, model,
+                    model == Intrinsics::DistortionModel::FTHETA
+                        ? kFthetaCoeffs
+                        : kCoeffs);
+}
+
+}  // namespace
+
+GTEST_TEST(IntrinsicsTest, ProjectModifiedBrownConrady) {
+  const Intrinsics intrinsics =
+      MakeIntrinsics(Intrinsics::DistortionModel::MODIFIED_BROWN_CONRADY);
+  const Eigen::Vector3f point(0.3, -0.2, 1.1);
+
+  // Distort the normalized coordinates by hand.
+  const auto& c = kCoeffs;
+  float x = point[0] / point[2];
+  float y = point[1] / point[2];
+  const float r2 = x * x + y * y;
+  const float f = 1 + c[0] * r2 + c[1] * r2 * r2 + c[4] * r2 * r2 * r2;
+  x *= f;
+  y *= f;
+  const float dx = x + 2 * c[2] * x * y + c[3] * (r2 + 2 * x * x);
+  const float dy = y + 2 * c[3] * x * y + c[2] * (r2 + 2 * y * y);
+
+  const Eigen::Vector2f pixel = intrinsics.Project(point);
+  EXPECT_NEAR(pixel[0], dx * 60 + 31.5, 1e-4);
+  EXPECT_NEAR(pixel[1], dy * 61 + 24.2, 1e-4);
+}
+
+GTEST_TEST(IntrinsicsTest, BatchMatchesSinglePoint) {
+  const int kSize = 37;
+  std::vector<float> x(kSize), y(kSize), z(kSize), u(kSize), v(kSize);
+  for (int i = 0; i < kSize; i++) {
+    x[i] = -0.4f + 0.02f * i;
+    y[i] = 0.3f - 0.015f * i;
+    z[i] = 0.5f + 0.05f * i;
+  }
+
+  for (auto model : kModels) {
+    const Intrinsics intrinsics = MakeIntrinsics(model);
+    intrinsics.ProjectBatch(x.data(), y.data(), z.data(), kSize, u.data(),
+                            v.data());
+    std::vector<float> bx(kSize), by(kSize), bz(kSize);
+    intrinsics.BackProjectBatch(u.data(), v.data(), z.data(), kSize,
+                                bx.data(), by.data(), bz.data());
+    for (int i = 0; i < kSize; i++) {
+      const Eigen::Vector2f pixel =
+          intrinsics.Project(Eigen::Vector3f(x[i], y[i], z[i]));
+      EXPECT_EQ(u[i], pixel[0]);
+      EXPECT_EQ(v[i], pixel[1]);
+      const Eigen::Vector3f point =
+          intrinsics.BackProject(Eigen::Vector2f(u[i], v[i]), z[i]);
+      EXPECT_EQ(bx[i], point[0]);
+      EXPECT_EQ(by[i], point[1]);
+      EXPECT_EQ(bz[i], point[2]);
+    }
+  }
+}
+
+GTEST_TEST(IntrinsicsTest, BackProjectInvertsProject) {
+  for (auto model : kModels) {
+    // INVERSE_BROWN_CONRADY only distorts back projection.
+    if (model == Intrinsics::DistortionModel::INVERSE_BROWN_CONRADY) continue;
+
+    const Intrinsics intrinsics = MakeIntrinsics(model);
+    for (float v = 0; v < intrinsics.height(); v += 3.7) {
+      for (float u = 0; u < intrinsics.width(); u += 4.1) {
+        const Eigen::Vector2f pixel(u, v);
+        const Eigen::Vector3f point = intrinsics.BackProject(pixel, 2);
+        EXPECT_FLOAT_EQ(point[2], 2);
+        EXPECT_LT((intrinsics.Project(point) - pixel).norm(), 1e-3)
+            << to_string(model) << " " << pixel.transpose();
+      }
+    }
+
+    // The principal point is singular for FTHETA.
+    const Eigen::Vector2f center(intrinsics.ppx(), intrinsics.ppy());
+    EXPECT_TRUE(intrinsics.BackProject(center, 1).isApprox(
+        Eigen::Vector3f(0, 0, 1)));
+    EXPECT_TRUE(
+        intrinsics.Project(Eigen::Vector3f(0, 0, 1)).isApprox(center));
+  }
+}
+
+GTEST_TEST(IntrinsicsTest, RayTable) {
+  for (auto model : kModels) {
+    const Intrinsics intrinsics = MakeIntrinsics(model);
+    const RayTable rays(intrinsics);
+    EXPECT_EQ(rays.width(), 64);
+    EXPECT_EQ(rays.height(), 48);
+
+    for (int v = 0; v < rays.height(); v++) {
+      for (int u = 0; u < rays.width(); u++) {
+        const Eigen::Vector3f expected =
+            intrinsics.BackProject(Eigen::Vector2f(u, v), 1.5);
+        EXPECT_TRUE(rays.BackProject(u, v, 1.5).isApprox(expected));
+      }
+    }
+  }
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,154 @@
+#include "rgbd_sensor/jpeg_codec.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "rgbd_sensor/image_conversions.h"
+
+namespace rs2_lcm {
+namespace {
+
+// A smooth gradient, which JPEG reproduces closely.
+std::vector<uint8_t> MakePixels(int width, int height, int channels) {
+  std::vector<uint8_t> pixels(width * height * channels);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < channels; c++) {
+        pixels[(y * width + x) * channels + c] = 40 + x + 2 * y + 30 * c;
+      }
+    }
+  }
+  return pixels;
+}
+
+int MaxError(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+  int error = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    error = std::max(error, std::abs(a[i] - b[i]));
+  }
+  return error;
+}
+
+}  // namespace
+
+GTEST_TEST(JpegCodecTest, RoundTrip) {
+  const int kWidth = 48;
+  const int kHeight = 32;
+  JpegEncoder encoder;
+  JpegDecoder decoder;
+  std::vector<uint8_t> data;
+  for (int channels : {1, 3}) {
+    const std::vector<uint8_t> pixels = MakePixels(kWidth, kHeight, channels);
+    for (auto subsampling :
+         {ChromaSubsampling::YUV444, ChromaSubsampling::YUV422,
+          ChromaSubsampling::YUV420}) {
+      encoder.Encode(pixels.data(), kWidth, kHeight, channels, 95, subsampling,
+                     &data);
+      std::vector<uint8_t> decoded(pixels.size());
+      decoder.Decode(data.data(), data.size(), kWidth, kHeight, channels,
+                     decoded.data());
+      EXPECT_LE(MaxError(pixels, decoded), 4) << channels;
+    }
+  }
+}
+
+GTEST_TEST(JpegCodecTest, Settings) {
+  const int kWidth = 64;
+  const int kHeight = 48;
+  std::vector<uint8_t> pixels = MakePixels(kWidth, kHeight, 3);
+  // Add detail, which costs more at higher quality.
+  for (size_t i = 0; i < pixels.size(); i += 7) pixels[i] ^= 0x55;
+
+  JpegEncoder encoder;
+  std::vector<uint8_t> low, high, full_chroma;
+  encoder.Encode(pixels.data(), kWidth, kHeight, 3, 30,
+                 ChromaSubsampling::YUV420, &low);
+  encoder.Encode(pixels.data(), kWidth, kHeight, 3, 95,
+                 ChromaSubsampling::YUV420, &high);
+  encoder.Encode(pixels.data(), kWidth, kHeight, 3, 95,
+                 ChromaSubsampling::YUV444, &full_chroma);
+  EXPECT_LT(low.size(), high.size());
+  EXPECT_LT(high.size(), full_chroma.size());
+
+  // The encoder is reconfigured for images of another size, and the output
+  // grows beyond its initial size.
+  const int kLargeWidth = 640;
+  const int kLargeHeight = 480;
+  std::vector<uint8_t> large(kLargeWidth * kLargeHeight * 3);
+  for (size_t i = 0; i < large.size(); i++) large[i] = (i * 7919) % 251;
+  std::vector<uint8_t> data;
+  encoder.Encode(large.data(), kLargeWidth, kLargeHeight, 3, 100,
+                 ChromaSubsampling::YUV444, &data);
+  JpegDecoder decoder;
+  std::vector<uint8_t> decoded(large.size());
+  decoder.Decode(data.data(), data.size(), kLargeWidth, kLargeHeight, 3,
+                 decoded.data());
+  EXPECT_GT(data.size(), 64u * 1024);
+}
+
+GTEST_TEST(JpegCodecTest, Yuyv) {
+  // Not a multiple of the 16 x 8 MCUs, to exercise the padding.
+  const int kWidth = 38;
+  const int kHeight = 21;
+  std::vector<uint8_t> yuyv(kWidth * kHeight * 2);
+  for (int y = 0; y < kHeight; y++) {
+    for (int x = 0; x < kWidth; x++) {
+      uint8_t* pixel = yuyv.data() + (y * kWidth + x) * 2;
+      pixel[0] = 40 + 3 * x + 2 * y;
+      // U for even, V for odd pixels.
+      pixel[1] = x % 2 ? 150 - y : 100 + y;
+    }
+  }
+  std::vector<uint8_t> rgb(kWidth * kHeight * 3);
+  YuyvToRgb(yuyv.data(), kWidth * 2, kWidth, kHeight, rgb.data());
+
+  JpegEncoder encoder;
+  JpegDecoder decoder;
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> decoded(rgb.size());
+  for (int i = 0; i < 2; i++) {
+    encoder.EncodeYuyv(yuyv.data(), kWidth, kHeight, 98, &data);
+    decoder.Decode(data.data(), data.size(), kWidth, kHeight, 3,
+                   decoded.data());
+    EXPECT_LE(MaxError(rgb, decoded), 8);
+
+    // Switching to RGB and back reconfigures the encoder.
+    encoder.Encode(rgb.data(), kWidth, kHeight, 3, 98,
+                   ChromaSubsampling::YUV422, &data);
+    decoder.Decode(data.data(), data.size(), kWidth, kHeight, 3,
+                   decoded.data());
+    EXPECT_LE(MaxError(rgb, decoded), 8);
+  }
+
+  EXPECT_THROW(encoder.EncodeYuyv(yuyv.data(), kWidth - 1, kHeight, 90, &data),
+               std::runtime_error);
+}
+
+GTEST_TEST(JpegCodecTest, Errors) {
+  const std::vector<uint8_t> pixels = MakePixels(16, 16, 3);
+  JpegEncoder encoder;
+  JpegDecoder decoder;
+  std::vector<uint8_t> data;
+  EXPECT_THROW(encoder.Encode(pixels.data(), 16, 16, 2, 90,
+                              ChromaSubsampling::YUV420, &data),
+               std::runtime_error);
+
+  encoder.Encode(pixels.data(), 16, 16, 3, 90, ChromaSubsampling::YUV420,
+                 &data);
+  std::vector<uint8_t> decoded(pixels.size());
+  EXPECT_THROW(decoder.Decode(data.data(), data.size(), 8, 16, 3,
+                              decoded.data()),
+               std::runtime_error);
+  const std::vector<uint8_t> garbage(100, 7);
+  EXPECT_THROW(decoder.Decode(garbage.data(), garbage.size(), 16, 16, 3,
+                              decoded.data()),
+               std::runtime_error);
+
+  // Both recover from errors.
+  decoder.Decode(data.data(), data.size(), 16, 16, 3, decoded.data());
+  EXPECT_LE(MaxError(pixels, decoded), 8);
+}
+
+}  // namespace rs2_lcm
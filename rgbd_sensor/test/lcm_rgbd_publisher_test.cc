@@ -0,0 +1,43 @@
+#include "rgbd_sensor/lcm_rgbd_publisher.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+namespace {
+
+// A sensor producing only RGB and DEPTH, so registered images must be
+// computed in software.
+class SyntheticSensor : public RGBDSensor {
+ public:
+  SyntheticSensor() : RGBDSensor({ImageType::RGB, ImageType::DEPTH}) {
+    set_intrinsics(ImageType::RGB, Intrinsics(4, 3, 2, 2, 2, 1.5));
+    set_intrinsics(ImageType::DEPTH, Intrinsics(4, 3, 2, 2, 2, 1.5));
+    set_extrinsics(ImageType::DEPTH, ImageType::RGB,
+                   Eigen::Isometry3f::Identity());
+  }
+
+  std::string camera_model() const override { return "synthetic"; }
+  const std::string& camera_id() const override { return id_; }
+
+ private:
+  void DoStart(const std::vector<ImageType>&) override {}
+  void DoStop() override {}
+
+  const std::string id_{"synthetic"};
+};
+
+GTEST_TEST(LcmRgbdPublisherTest, DescribesSoftwareRegisteredImages) {
+  SyntheticSensor sensor;
+  lcm::LCM lcm("memq://");
+  LcmRgbdPublisher publisher(
+      {ImageType::RGB, ImageType::DEPTH, ImageType::RECT_RGB_ALIGNED_DEPTH,
+       ImageType::DEPTH_ALIGNED_RGB},
+      "synthetic", "DESCRIPTION", "IMAGES", &sensor, &lcm);
+  EXPECT_NO_THROW(publisher.PublishDescription());
+}
+
+}  // namespace
+}  // namespace rs2_lcm
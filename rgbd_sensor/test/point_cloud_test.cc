@@ -0,0 +1,211 @@
+#include "rgbd_sensor/point_cloud.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+namespace {
+
+const std::array<float, 5> kCoeffs{0.05f, -0.02f, 0.001f, 0.002f, 0.f};
+
+RawImageData MakeDepth(int rows, int cols) {
+  RawImageData depth(rows, cols, 1, 2);
+  for (int v = 0; v < rows; v++) {
+    for (int u = 0; u < cols; u++) {
+      depth.at<uint16_t>(v, u) = (u * 3 + v) % 7 == 0 ? 0 : 500 + u + 2 * v;
+    }
+  }
+  return depth;
+}
+
+// A sensor with identical depth and color cameras.
+class SyntheticSensor : public RGBDSensor {
+ public:
+  SyntheticSensor() : RGBDSensor({ImageType::RGB, ImageType::DEPTH}) {
+    const Intrinsics intrinsics(
+        40, 30, 35, 36, 19.5, 14.5,
+        Intrinsics::DistortionModel::INVERSE_BROWN_CONRADY, kCoeffs);
+    set_intrinsics(ImageType::RGB, Intrinsics(40, 30, 35, 36, 19.5, 14.5));
+    set_intrinsics(ImageType::DEPTH, intrinsics);
+  }
+
+  std::string camera_model() const override { return "synthetic"; }
+  const std::string& camera_id() const override { return id_; }
+
+  void Push(uint64_t timestamp) {
+    std::map<const ImageType, TimeStampedImage> images;
+    images[ImageType::DEPTH].timestamp = timestamp;
+    images[ImageType::DEPTH].data =
+        std::make_shared<RawImageData>(MakeDepth(30, 40));
+    auto color = RawImageData::MakeSharedRawImageData<uint8_t>(30, 40, 3);
+    for (int v = 0; v < 30; v++) {
+      for (int u = 0; u < 40; u++) {
+        color->at<uint8_t>(v, u, 0) = u;
+        color->at<uint8_t>(v, u, 1) = v;
+        color->at<uint8_t>(v, u, 2) = 200;
+      }
+    }
+    images[ImageType::RGB].timestamp = timestamp;
+    images[ImageType::RGB].data = color;
+    UpdateImages(images);
+  }
+
+ private:
+  void DoStart(const std::vector<ImageType>&) override {}
+  void DoStop() override {}
+
+  const std::string id_{"synthetic"};
+};
+
+}  // namespace
+
+GTEST_TEST(PointCloudTest, ComputePointCloud) {
+  const Intrinsics intrinsics(
+      64, 48, 60, 61, 31.5, 24.2,
+      Intrinsics::DistortionModel::INVERSE_BROWN_CONRADY, kCoeffs);
+  const RayTable rays(intrinsics);
+  const RawImageData depth = MakeDepth(48, 64);
+
+  RawImageData points(48, 64, 3, 3 * sizeof(float));
+  ComputePointCloud(rays, depth, &points);
+  for (int v = 0; v < depth.rows(); v++) {
+    for (int u = 0; u < depth.cols(); u++) {
+      const uint16_t z = depth.at<uint16_t>(v, u);
+      if (z == 0) {
+        for (int c = 0; c < 3; c++) {
+          EXPECT_TRUE(std::isnan(points.at<float>(v, u, c)));
+        }
+        continue;
+      }
+      const Eigen::Vector3f expected =
+          intrinsics.BackProject(Eigen::Vector2f(u, v), z / 1000.f);
+      for (int c = 0; c < 3; c++) {
+        EXPECT_NEAR(points.at<float>(v, u, c), expected[c], 1e-6);
+      }
+    }
+  }
+
+  RawImageData wrong_size(48, 63, 3, 3 * sizeof(float));
+  EXPECT_THROW(ComputePointCloud(rays, depth, &wrong_size),
+               std::runtime_error);
+}
+
+GTEST_TEST(PointCloudTest, ComputeColoredPointCloud) {
+  const RayTable rays(Intrinsics(4, 2, 2, 2, 1.5, 0.5));
+  RawImageData depth(2, 4, 1, 2);
+  depth.mutable_slice<uint16_t>().setConstant(1000);
+  RawImageData color(2, 4, 3, 3);
+  color.at<uint8_t>(1, 2, 0) = 0x12;
+  color.at<uint8_t>(1, 2, 1) = 0x34;
+  color.at<uint8_t>(1, 2, 2) = 0x56;
+
+  RawImageData points(2, 4, 4, 4 * sizeof(float));
+  ComputeColoredPointCloud(rays, depth, color, &points);
+  EXPECT_FLOAT_EQ(points.at<float>(1, 2, 0), 0.25f);
+  EXPECT_FLOAT_EQ(points.at<float>(1, 2, 1), 0.25f);
+  EXPECT_FLOAT_EQ(points.at<float>(1, 2, 2), 1.f);
+  uint32_t rgb;
+  memcpy(&rgb, &points.at<float>(1, 2, 3), sizeof(rgb));
+  EXPECT_EQ(rgb, 0x123456u);
+}
+
+GTEST_TEST(PointCloudTest, VoxelGridFilter) {
+  RawImageData points(1, 5, 4, 4 * sizeof(float));
+  const float kNaN = std::numeric_limits<float>::quiet_NaN();
+  const float xyz[5][3] = {{0.01, 0.01, 1.01},
+                           {0.03, 0.05, 1.07},
+                           {kNaN, kNaN, kNaN},
+                           {-0.01, 0.01, 1.01},
+                           {0.15, 0.01, 1.01}};
+  const uint32_t rgb[5] = {0x102030, 0x304050, 0, 0xffffff, 0x000000};
+  for (int i = 0; i < 5; i++) {
+    for (int c = 0; c < 3; c++) points.at<float>(0, i, c) = xyz[i][c];
+    memcpy(&points.at<float>(0, i, 3), &rgb[i], sizeof(rgb[i]));
+  }
+
+  // The first two points share a voxel, the others have one each.
+  const RawImageData filtered = VoxelGridFilter(points, 0.1);
+  ASSERT_EQ(filtered.rows(), 1);
+  ASSERT_EQ(filtered.cols(), 3);
+  EXPECT_FLOAT_EQ(filtered.at<float>(0, 0, 0), 0.02f);
+  EXPECT_FLOAT_EQ(filtered.at<float>(0, 0, 1), 0.03f);
+  EXPECT_FLOAT_EQ(filtered.at<float>(0, 0, 2), 1.04f);
+  uint32_t mean;
+  memcpy(&mean, &filtered.at<float>(0, 0, 3), sizeof(mean));
+  EXPECT_EQ(mean, 0x203040u);
+  EXPECT_FLOAT_EQ(filtered.at<float>(0, 1, 0), -0.01f);
+  EXPECT_FLOAT_EQ(filtered.at<float>(0, 2, 0), 0.15f);
+
+  std::vector<uint8_t> data;
+  EXPECT_EQ(VoxelGridFilter(points, 0.1, &data), 3);
+  ASSERT_EQ(data.size(), static_cast<size_t>(filtered.size()));
+  EXPECT_EQ(memcmp(data.data(), filtered.data(), data.size()), 0);
+
+  EXPECT_THROW(VoxelGridFilter(points, 0), std::runtime_error);
+}
+
+GTEST_TEST(PointCloudTest, Generator) {
+  SyntheticSensor sensor;
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+
+  PointCloudGenerator xyz(&sensor, false);
+  PointCloudGenerator xyzrgb(&sensor, true);
+  uint64_t timestamp = 0;
+  EXPECT_EQ(xyz.Compute(*sensor.GetLatestFrameset(), &timestamp), nullptr);
+
+  sensor.Push(7);
+  const auto frameset = sensor.GetLatestFrameset();
+  const auto points = xyz.Compute(*frameset, &timestamp);
+  ASSERT_NE(points, nullptr);
+  EXPECT_EQ(timestamp, 7);
+  EXPECT_EQ(points->channels(), 3);
+
+  const auto colored = xyzrgb.Compute(*frameset, &timestamp);
+  ASSERT_NE(colored, nullptr);
+  EXPECT_EQ(colored->channels(), 4);
+  for (int v = 0; v < points->rows(); v++) {
+    for (int u = 0; u < points->cols(); u++) {
+      for (int c = 0; c < 3; c++) {
+        const float p = points->at<float>(v, u, c);
+        const float q = colored->at<float>(v, u, c);
+        EXPECT_TRUE(p == q || (std::isnan(p) && std::isnan(q)));
+      }
+    }
+  }
+
+  // The same points can be written into a caller's buffer.
+  std::vector<uint8_t> data;
+  int rows = 0;
+  int cols = 0;
+  ASSERT_TRUE(xyzrgb.ComputeInto(*frameset, &timestamp, &data, &rows, &cols));
+  EXPECT_EQ(rows, colored->rows());
+  EXPECT_EQ(cols, colored->cols());
+  ASSERT_EQ(data.size(), static_cast<size_t>(colored->size()));
+  EXPECT_EQ(xyzrgb.point_step(), 16);
+  for (int i = 0; i < colored->size() / 4; i++) {
+    float p, q;
+    memcpy(&p, colored->data() + 4 * i, 4);
+    memcpy(&q, data.data() + 4 * i, 4);
+    EXPECT_TRUE(p == q || (std::isnan(p) && std::isnan(q)));
+  }
+
+  // Thinned clouds are unorganized.
+  xyz.set_voxel_size(1);
+  const auto thinned = xyz.Compute(*frameset, &timestamp);
+  ASSERT_NE(thinned, nullptr);
+  EXPECT_EQ(thinned->rows(), 1);
+  EXPECT_LT(thinned->cols(), points->rows() * points->cols());
+  ASSERT_TRUE(xyz.ComputeInto(*frameset, &timestamp, &data, &rows, &cols));
+  EXPECT_EQ(rows, 1);
+  EXPECT_EQ(cols, thinned->cols());
+  EXPECT_EQ(data.size(), static_cast<size_t>(thinned->size()));
+  sensor.Stop();
+}
+
+}  // namespace rs2_lcm
@@ -0,0 +1,581 @@
+#include "rgbd_sensor/rgbd_sensor.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "rgbd_sensor/depth_registration_stage.h"
+
+namespace rs2_lcm {
+namespace {
+
+// A sensor whose images are pushed by the test.
+class SyntheticSensor : public RGBDSensor {
+ public:
+  SyntheticSensor() : RGBDSensor({ImageType::RGB, ImageType::DEPTH}) {
+    set_intrinsics(ImageType::RGB, Intrinsics(4, 3, 2, 2, 2, 1.5));
+    set_intrinsics(ImageType::DEPTH, Intrinsics(4, 3, 2, 2, 2, 1.5));
+    set_extrinsics(ImageType::DEPTH, ImageType::RGB,
+                   Eigen::Isometry3f::Identity());
+  }
+
+  std::string camera_model() const override { return "synthetic"; }
+  const std::string& camera_id() const override { return id_; }
+
+  void Push(ImageType type, uint64_t timestamp) {
+    Push(std::vector<ImageType>{type}, timestamp);
+  }
+
+  void Push(const std::vector<ImageType>& types, uint64_t timestamp) {
+    std::map<const ImageType, TimeStampedImage> images;
+    for (ImageType type : types) {
+      images[type].timestamp = timestamp;
+      if (type == ImageType::RGB) {
+        images[type].data =
+            RawImageData::MakeSharedRawImageData<uint8_t>(3, 4, 3);
+      } else {
+        auto depth = RawImageData::MakeSharedRawImageData<uint16_t>(3, 4, 1);
+        depth->mutable_slice<uint16_t>().setConstant(1000 + timestamp);
+        images[type].data = depth;
+      }
+    }
+    UpdateImages(images);
+  }
+
+  // Pushes a video range white RGB image captured as YUYV.
+  void PushYuyv(uint64_t timestamp) {
+    auto yuyv = RawImageData::MakeSharedRawImageData<uint8_t>(3, 4, 2);
+    for (int i = 0; i < yuyv->size(); i++) {
+      yuyv->data()[i] = i % 2 ? 128 : 235;
+    }
+    std::map<const ImageType, TimeStampedImage> images;
+    images[ImageType::RGB] = {yuyv, timestamp};
+    UpdateImages(images);
+  }
+
+ private:
+  void DoStart(const std::vector<ImageType>&) override {}
+  void DoStop() override {}
+
+  const std::string id_{"synthetic"};
+};
+
+// The original single threaded registration, as a reference.
+RawImageData ReferenceRegisterDepthToColor(
+    const Intrinsics& color_intrinsics, const Intrinsics& depth_intrinsics,
+    const Eigen::Isometry3f& X_rgb_depth, const RawImageData& color,
+    const RawImageData& depth) {
+  RawImageData depth_registered(color.rows(), color.cols(), 1, 2);
+  auto depth_registered_view = depth_registered.mutable_slice<uint16_t>();
+  auto depth_view = depth.slice<uint16_t>();
+  depth_registered_view.setZero();
+
+  for (int v = 0; v < depth.rows(); v++) {
+    for (int u = 0; u < depth.cols(); u++) {
+      const float z = depth_view(v, u) / 1000.;
+      if (z == 0) {
+        continue;
+      }
+
+      const Eigen::Vector3f P_depth =
+          depth_intrinsics.BackProject(Eigen::Vector2f(u, v), z);
+      const Eigen::Vector3f P_rgb = X_rgb_depth * P_depth;
+      const Eigen::Vector2f p_rgb = color_intrinsics.Project(P_rgb);
+      const int px = static_cast<int>(std::round(p_rgb(0)));
+      const int py = static_cast<int>(std::round(p_rgb(1)));
+      if (px >= 0 && py >= 0 && px < color.cols() && py < color.rows()) {
+        if (depth_registered_view(py, px) == 0 ||
+            static_cast<float>(depth_registered_view(py, px)) >
+                P_rgb[2] * 1000.0) {
+          depth_registered_view(py, px) =
+              static_cast<uint16_t>(std::round(P_rgb[2] * 1000.0));
+        }
+      }
+    }
+  }
+  return depth_registered;
+}
+
+}  // namespace
+
+GTEST_TEST(RGBDSensorTest, RegisterDepthToColor) {
+  const std::array<float, 5> kCoeffs{0.05f, -0.02f, 0.001f, 0.002f, 0.f};
+  const Intrinsics depth_intrinsics(
+      160, 120, 150, 152, 80.5, 59.5,
+      Intrinsics::DistortionModel::INVERSE_BROWN_CONRADY, kCoeffs);
+  const RayTable depth_rays(depth_intrinsics);
+
+  // A tilted plane with a box in front of it, so that occlusions have to be
+  // resolved, and a few holes.
+  RawImageData depth(120, 160, 1, 2);
+  for (int v = 0; v < depth.rows(); v++) {
+    for (int u = 0; u < depth.cols(); u++) {
+      uint16_t z = 1500 + 3 * u + v;
+      if (u > 60 && u < 90 && v > 40 && v < 70) z = 600;
+      if ((u * 7 + v * 13) % 17 == 0) z = 0;
+      depth.at<uint16_t>(v, u) = z;
+    }
+  }
+
+  Eigen::Isometry3f X_rgb_depth = Eigen::Isometry3f::Identity();
+  X_rgb_depth.linear() =
+      Eigen::AngleAxisf(0.05, Eigen::Vector3f(0.2, 1, 0.1).normalized())
+          .toRotationMatrix();
+  X_rgb_depth.translation() = Eigen::Vector3f(-0.05, 0.002, 0.001);
+
+  for (auto model : {Intrinsics::DistortionModel::NONE,
+                     Intrinsics::DistortionModel::MODIFIED_BROWN_CONRADY}) {
+    const Intrinsics color_intrinsics(200, 150, 170, 171, 99.7, 75.2, model,
+                                      kCoeffs);
+    const RawImageData color(150, 200, 3, 3);
+    const RawImageData expected = ReferenceRegisterDepthToColor(
+        color_intrinsics, depth_intrinsics, X_rgb_depth, color, depth);
+    const RawImageData registered =
+        DoRegisterDepthToColor(color_intrinsics, depth_rays, X_rgb_depth,
+                               color, depth, ImageType::DEPTH);
+    ASSERT_EQ(registered.rows(), expected.rows());
+    ASSERT_EQ(registered.cols(), expected.cols());
+    int num_valid = 0;
+    for (int v = 0; v < expected.rows(); v++) {
+      for (int u = 0; u < expected.cols(); u++) {
+        EXPECT_EQ(registered.at<uint16_t>(v, u), expected.at<uint16_t>(v, u));
+        if (expected.at<uint16_t>(v, u)) num_valid++;
+      }
+    }
+    EXPECT_GT(num_valid, expected.rows() * expected.cols() / 4);
+  }
+}
+
+GTEST_TEST(RGBDSensorTest, RegisterColorToDepth) {
+  const std::array<float, 5> kCoeffs{0.05f, -0.02f, 0.001f, 0.002f, 0.f};
+  const Intrinsics depth_intrinsics(
+      160, 120, 150, 152, 80.5, 59.5,
+      Intrinsics::DistortionModel::INVERSE_BROWN_CONRADY, kCoeffs);
+  const Intrinsics color_intrinsics(
+      200, 150, 170, 171, 99.7, 75.2,
+      Intrinsics::DistortionModel::MODIFIED_BROWN_CONRADY, kCoeffs);
+  const RayTable depth_rays(depth_intrinsics);
+
+  RawImageData depth(120, 160, 1, 2);
+  for (int v = 0; v < depth.rows(); v++) {
+    for (int u = 0; u < depth.cols(); u++) {
+      depth.at<uint16_t>(v, u) = (u + v) % 11 == 0 ? 0 : 800 + 2 * u + v;
+    }
+  }
+  RawImageData color(150, 200, 3, 3);
+  for (int v = 0; v < color.rows(); v++) {
+    for (int u = 0; u < color.cols(); u++) {
+      color.at<uint8_t>(v, u, 0) = u;
+      color.at<uint8_t>(v, u, 1) = v;
+      color.at<uint8_t>(v, u, 2) = u ^ v;
+    }
+  }
+
+  Eigen::Isometry3f X_rgb_depth = Eigen::Isometry3f::Identity();
+  X_rgb_depth.translation() = Eigen::Vector3f(0.015, -0.002, 0.001);
+
+  const RawImageData uv_map = DoComputeColorUvMap(color_intrinsics, depth_rays,
+                                                  X_rgb_depth, depth);
+  const RawImageData registered = DoRegisterColorToDepth(color, uv_map);
+  ASSERT_EQ(registered.rows(), depth.rows());
+  ASSERT_EQ(registered.cols(), depth.cols());
+  ASSERT_EQ(registered.channels(), 3);
+
+  int num_colored = 0;
+  for (int v = 0; v < depth.rows(); v++) {
+    for (int u = 0; u < depth.cols(); u++) {
+      const uint16_t z = depth.at<uint16_t>(v, u);
+      if (z == 0) {
+        EXPECT_EQ(uv_map.at<float>(v, u, 0), -1.f);
+        for (int c = 0; c < 3; c++) {
+          EXPECT_EQ(registered.at<uint8_t>(v, u, c), 0);
+        }
+        continue;
+      }
+
+      const Eigen::Vector3f P_depth =
+          depth_intrinsics.BackProject(Eigen::Vector2f(u, v), z / 1000.f);
+      const Eigen::Vector2f p_rgb =
+          color_intrinsics.Project(X_rgb_depth * P_depth);
+      EXPECT_NEAR(uv_map.at<float>(v, u, 0), p_rgb(0), 1e-2);
+      EXPECT_NEAR(uv_map.at<float>(v, u, 1), p_rgb(1), 1e-2);
+
+      const int px = static_cast<int>(std::round(uv_map.at<float>(v, u, 0)));
+      const int py = static_cast<int>(std::round(uv_map.at<float>(v, u, 1)));
+      if (px < 0 || py < 0 || px >= color.cols() || py >= color.rows()) {
+        continue;
+      }
+      for (int c = 0; c < 3; c++) {
+        EXPECT_EQ(registered.at<uint8_t>(v, u, c),
+                  color.at<uint8_t>(py, px, c));
+      }
+      num_colored++;
+    }
+  }
+  EXPECT_GT(num_colored, depth.rows() * depth.cols() / 2);
+}
+
+GTEST_TEST(RGBDSensorTest, RegisterBehindColorCamera) {
+  const Intrinsics intrinsics(16, 12, 15, 15, 7.5, 5.5);
+  const RayTable depth_rays(intrinsics);
+  RawImageData depth(12, 16, 1, 2);
+  // Half the points land at, the other half behind the color camera, where
+  // they project to infinite or meaningless pixels.
+  for (int v = 0; v < depth.rows(); v++) {
+    for (int u = 0; u < depth.cols(); u++) {
+      depth.at<uint16_t>(v, u) = u % 2 ? 1000 : 500;
+    }
+  }
+  Eigen::Isometry3f X_rgb_depth = Eigen::Isometry3f::Identity();
+  X_rgb_depth.translation() = Eigen::Vector3f(0, 0, -1);
+  const RawImageData color(12, 16, 3, 3);
+
+  const RawImageData registered = DoRegisterDepthToColor(
+      intrinsics, depth_rays, X_rgb_depth, color, depth, ImageType::DEPTH);
+  const RawImageData uv_map =
+      DoComputeColorUvMap(intrinsics, depth_rays, X_rgb_depth, depth);
+  for (int v = 0; v < depth.rows(); v++) {
+    for (int u = 0; u < depth.cols(); u++) {
+      EXPECT_EQ(registered.at<uint16_t>(v, u), 0);
+      EXPECT_EQ(uv_map.at<float>(v, u, 0), -1.f);
+    }
+  }
+
+  // Non finite and far off coordinates are skipped.
+  RawImageData bad_uv_map(1, 4, 2, 2 * sizeof(float));
+  const float kBad[4] = {std::numeric_limits<float>::quiet_NaN(),
+                         std::numeric_limits<float>::infinity(), 1e20f,
+                         -1e20f};
+  for (int u = 0; u < 4; u++) {
+    bad_uv_map.at<float>(0, u, 0) = kBad[u];
+    bad_uv_map.at<float>(0, u, 1) = 1;
+  }
+  RawImageData white(12, 16, 3, 3);
+  memset(white.data(), 255, white.size());
+  const RawImageData colored = DoRegisterColorToDepth(white, bad_uv_map);
+  for (int u = 0; u < 4; u++) {
+    EXPECT_EQ(colored.at<uint8_t>(0, u, 0), 0);
+  }
+}
+
+GTEST_TEST(RGBDSensorTest, LatestImage) {
+  SyntheticSensor sensor;
+  sensor.Start({ImageType::DEPTH});
+  EXPECT_TRUE(sensor.is_enabled(ImageType::DEPTH));
+  EXPECT_FALSE(sensor.is_enabled(ImageType::RGB));
+
+  uint64_t timestamp = 1;
+  EXPECT_EQ(sensor.GetLatestImage(ImageType::DEPTH, &timestamp), nullptr);
+  EXPECT_EQ(timestamp, 0);
+  EXPECT_EQ(sensor.get_image_sequence(ImageType::DEPTH), 0);
+
+  sensor.Push(ImageType::DEPTH, 33);
+  EXPECT_NE(sensor.GetLatestImage(ImageType::DEPTH, &timestamp), nullptr);
+  EXPECT_EQ(timestamp, 33);
+  EXPECT_EQ(sensor.get_image_sequence(ImageType::DEPTH), 1);
+  EXPECT_EQ(sensor.get_image_sequence(ImageType::RGB), 0);
+
+  sensor.Stop();
+  EXPECT_FALSE(sensor.is_enabled(ImageType::DEPTH));
+}
+
+GTEST_TEST(RGBDSensorTest, Frameset) {
+  SyntheticSensor sensor;
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+  uint64_t timestamp = 0;
+
+  sensor.Push({ImageType::RGB, ImageType::DEPTH}, 10);
+  auto first = sensor.GetLatestFrameset();
+  EXPECT_EQ(first->sequence, 1);
+  EXPECT_NE(first->image(ImageType::RGB, &timestamp), nullptr);
+  EXPECT_EQ(timestamp, 10);
+  EXPECT_NE(first->image(ImageType::DEPTH, &timestamp), nullptr);
+  EXPECT_EQ(timestamp, 10);
+
+  // Types missing from an update carry over, and older framesets are not
+  // modified.
+  sensor.Push(ImageType::DEPTH, 20);
+  auto second = sensor.GetLatestFrameset();
+  EXPECT_EQ(second->sequence, 2);
+  EXPECT_EQ(second->image(ImageType::RGB, &timestamp),
+            first->image(ImageType::RGB, &timestamp));
+  EXPECT_EQ(timestamp, 10);
+  second->image(ImageType::DEPTH, &timestamp);
+  EXPECT_EQ(timestamp, 20);
+  first->image(ImageType::DEPTH, &timestamp);
+  EXPECT_EQ(timestamp, 10);
+
+  sensor.Stop();
+  EXPECT_EQ(sensor.GetLatestFrameset()->sequence, 0);
+}
+
+GTEST_TEST(RGBDSensorTest, History) {
+  SyntheticSensor sensor;
+  sensor.set_history_depth(2);
+  sensor.Start({ImageType::DEPTH});
+  for (uint64_t t = 10; t <= 30; t += 10) sensor.Push(ImageType::DEPTH, t);
+
+  uint64_t timestamp = 0;
+  auto latest = sensor.GetLatestImage(ImageType::DEPTH, &timestamp);
+  EXPECT_EQ(sensor.GetImageNearest(ImageType::DEPTH, 29, &timestamp), latest);
+  EXPECT_EQ(timestamp, 30);
+  EXPECT_NE(sensor.GetImageNearest(ImageType::DEPTH, 0, &timestamp), nullptr);
+  EXPECT_EQ(timestamp, 20);
+  EXPECT_EQ(sensor.GetImagesInRange(ImageType::DEPTH, 0, 100).size(), 2);
+  EXPECT_EQ(sensor.GetImageNearest(ImageType::RGB, 0, &timestamp), nullptr);
+
+  sensor.Stop();
+  EXPECT_TRUE(sensor.GetImagesInRange(ImageType::DEPTH, 0, 100).empty());
+}
+
+GTEST_TEST(RGBDSensorTest, RayTable) {
+  SyntheticSensor sensor;
+  auto rays = sensor.get_ray_table(ImageType::DEPTH);
+  EXPECT_EQ(sensor.get_ray_table(ImageType::DEPTH), rays);
+  EXPECT_THROW(sensor.get_ray_table(ImageType::IR), std::exception);
+
+  // Changing the intrinsics invalidates the cached table.
+  sensor.set_intrinsics(ImageType::DEPTH, Intrinsics(8, 6, 4, 4, 4, 3));
+  auto new_rays = sensor.get_ray_table(ImageType::DEPTH);
+  EXPECT_NE(new_rays, rays);
+  EXPECT_EQ(new_rays->width(), 8);
+  EXPECT_EQ(rays->width(), 4);
+}
+
+GTEST_TEST(RGBDSensorTest, DepthDecimation) {
+  SyntheticSensor sensor;
+  // The pushed 4x3 images are cropped to 4x2 blocks.
+  sensor.set_intrinsics(ImageType::DEPTH, Intrinsics(4, 2, 2, 2, 2, 1));
+  EXPECT_THROW(sensor.set_depth_decimation(0, DecimationMethod::MIN),
+               std::runtime_error);
+  sensor.set_depth_decimation(2, DecimationMethod::MIN);
+  EXPECT_EQ(sensor.get_depth_decimation_factor(), 2);
+  EXPECT_EQ(sensor.get_depth_decimation_method(), DecimationMethod::MIN);
+
+  // Both the intrinsics and the images are decimated while started.
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+  EXPECT_EQ(sensor.get_intrinsics(ImageType::DEPTH).width(), 2);
+  EXPECT_EQ(sensor.get_ray_table(ImageType::DEPTH)->width(), 2);
+  sensor.Push({ImageType::RGB, ImageType::DEPTH}, 1);
+  uint64_t timestamp = 0;
+  auto depth = sensor.GetLatestImage(ImageType::DEPTH, &timestamp);
+  EXPECT_EQ(timestamp, 1);
+  EXPECT_EQ(depth->rows(), 1);
+  EXPECT_EQ(depth->cols(), 2);
+  EXPECT_EQ(depth->at<uint16_t>(0, 1), 1001);
+  EXPECT_EQ(sensor.GetLatestImage(ImageType::RGB, &timestamp)->cols(), 4);
+
+  // Registration works at the decimated resolution.
+  auto aligned = sensor.GetDerivedImage(ImageType::DEPTH_ALIGNED_RGB,
+                                        *sensor.GetLatestFrameset());
+  EXPECT_EQ(aligned->cols(), 2);
+
+  // Starting again does not decimate twice.
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+  EXPECT_EQ(sensor.get_intrinsics(ImageType::DEPTH).width(), 2);
+
+  sensor.Stop();
+  EXPECT_EQ(sensor.get_intrinsics(ImageType::DEPTH).width(), 4);
+}
+
+GTEST_TEST(RGBDSensorTest, YuyvColor) {
+  SyntheticSensor sensor;
+  sensor.set_history_depth(2);
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+  sensor.PushYuyv(5);
+  sensor.Push(ImageType::DEPTH, 5);
+
+  auto frameset = sensor.GetLatestFrameset();
+  EXPECT_TRUE(frameset->has_image(ImageType::RGB));
+  EXPECT_EQ(frameset->images.at(static_cast<int>(ImageType::RGB)), nullptr);
+  ASSERT_NE(frameset->yuyv_color, nullptr);
+  EXPECT_EQ(frameset->yuyv_color->yuyv()->channels(), 2);
+
+  // Converted on first use, once.
+  uint64_t timestamp = 0;
+  const auto rgb = frameset->image(ImageType::RGB, &timestamp);
+  EXPECT_EQ(timestamp, 5);
+  ASSERT_NE(rgb, nullptr);
+  EXPECT_EQ(rgb->channels(), 3);
+  EXPECT_EQ(rgb->cols(), 4);
+  EXPECT_EQ(rgb->at<uint8_t>(1, 2, 1), 255);
+  EXPECT_EQ(frameset->image(ImageType::RGB, &timestamp), rgb);
+  EXPECT_EQ(sensor.GetLatestImage(ImageType::RGB, &timestamp), rgb);
+  EXPECT_EQ(sensor.GetImageNearest(ImageType::RGB, 5, &timestamp), rgb);
+
+  // Registration takes the converted image.
+  auto aligned =
+      sensor.GetDerivedImage(ImageType::DEPTH_ALIGNED_RGB, *frameset);
+  ASSERT_NE(aligned, nullptr);
+  EXPECT_EQ(aligned->at<uint8_t>(1, 2, 0), 255);
+
+  // RGB captures replace it.
+  sensor.Push(ImageType::RGB, 6);
+  frameset = sensor.GetLatestFrameset();
+  EXPECT_EQ(frameset->yuyv_color, nullptr);
+  EXPECT_EQ(frameset->image(ImageType::RGB, &timestamp)->channels(), 3);
+  EXPECT_EQ(timestamp, 6);
+
+  EXPECT_THROW(YuyvColorImage(
+                   RawImageData::MakeSharedRawImageData<uint8_t>(3, 4, 3)),
+               std::runtime_error);
+}
+
+GTEST_TEST(RGBDSensorTest, WaitForNewFrameTimeout) {
+  SyntheticSensor sensor;
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+  EXPECT_EQ(sensor.WaitForNewFrame(ImageType::DEPTH, 0,
+                                   std::chrono::milliseconds(1)),
+            0);
+  sensor.Push(ImageType::RGB, 1);
+  EXPECT_EQ(sensor.WaitForNewFrame(ImageType::DEPTH, 0,
+                                   std::chrono::milliseconds(1)),
+            0);
+  sensor.Push(ImageType::DEPTH, 1);
+  EXPECT_EQ(sensor.WaitForNewFrame(ImageType::DEPTH, 0,
+                                   std::chrono::milliseconds(1)),
+            1);
+  sensor.Stop();
+}
+
+// Measures the delay between an image landing in the sensor and a waiting
+// consumer waking up, which used to be up to the 5ms polling period.
+GTEST_TEST(RGBDSensorTest, WakeUpLatency) {
+  using Clock = std::chrono::steady_clock;
+  const int kFrames = 20;
+
+  SyntheticSensor sensor;
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+
+  std::vector<Clock::time_point> pushed(kFrames);
+  std::vector<Clock::time_point> woken(kFrames);
+  std::thread consumer([&]() {
+    uint64_t last_seen = 0;
+    for (int i = 0; i < kFrames; i++) {
+      last_seen = sensor.WaitForNewFrame(ImageType::DEPTH, last_seen,
+                                         std::chrono::seconds(5));
+      woken[i] = Clock::now();
+    }
+  });
+  for (int i = 0; i < kFrames; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    pushed[i] = Clock::now();
+    sensor.Push(ImageType::DEPTH, i + 1);
+  }
+  consumer.join();
+
+  std::vector<Clock::duration> latencies;
+  for (int i = 0; i < kFrames; i++) latencies.push_back(woken[i] - pushed[i]);
+  std::sort(latencies.begin(), latencies.end());
+  EXPECT_LT(latencies[kFrames / 2], std::chrono::milliseconds(1));
+
+  // The fd is readable after an update, until it is cleared.
+  pollfd fd{sensor.new_frame_fd(), POLLIN, 0};
+  EXPECT_EQ(poll(&fd, 1, 0), 1);
+  sensor.ClearNewFrameFd();
+  EXPECT_EQ(poll(&fd, 1, 0), 0);
+  sensor.Push(ImageType::RGB, 100);
+  EXPECT_EQ(poll(&fd, 1, 0), 1);
+
+  sensor.Stop();
+}
+
+GTEST_TEST(RGBDSensorTest, DerivedImage) {
+  SyntheticSensor sensor;
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+  EXPECT_THROW(
+      sensor.GetDerivedImage(ImageType::IR, *sensor.GetLatestFrameset()),
+      std::runtime_error);
+
+  sensor.Push(ImageType::DEPTH, 1);
+  EXPECT_EQ(sensor.GetDerivedImage(ImageType::RECT_RGB_ALIGNED_DEPTH,
+                                   *sensor.GetLatestFrameset()),
+            nullptr);
+
+  sensor.Push({ImageType::RGB, ImageType::DEPTH}, 2);
+  const auto frameset = sensor.GetLatestFrameset();
+
+  // Concurrent requests share one computation.
+  std::vector<std::shared_ptr<const RawImageData>> results(4);
+  std::vector<std::thread> threads;
+  for (auto& result : results) {
+    threads.emplace_back([&]() {
+      result = sensor.GetDerivedImage(ImageType::RECT_RGB_ALIGNED_DEPTH,
+                                      *frameset);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  ASSERT_NE(results[0], nullptr);
+  for (const auto& result : results) EXPECT_EQ(result, results[0]);
+  EXPECT_EQ(results[0]->at<uint16_t>(1, 2), 1002);
+
+  const auto color =
+      sensor.GetDerivedImage(ImageType::DEPTH_ALIGNED_RGB, *frameset);
+  ASSERT_NE(color, nullptr);
+  EXPECT_EQ(color->channels(), 3);
+  EXPECT_EQ(sensor.GetDerivedImage(ImageType::DEPTH_ALIGNED_RGB, *frameset),
+            color);
+  EXPECT_NE(sensor.GetColorUvMap(*frameset), nullptr);
+
+  // New calibration invalidates the memoized images.
+  const uint64_t generation = sensor.get_calibration_generation();
+  sensor.set_extrinsics(ImageType::DEPTH, ImageType::RGB,
+                        Eigen::Isometry3f::Identity());
+  EXPECT_GT(sensor.get_calibration_generation(), generation);
+  EXPECT_NE(
+      sensor.GetDerivedImage(ImageType::RECT_RGB_ALIGNED_DEPTH, *frameset),
+      results[0]);
+
+  // So do new images.
+  sensor.Push(ImageType::DEPTH, 3);
+  const auto next = sensor.GetDerivedImage(ImageType::RECT_RGB_ALIGNED_DEPTH,
+                                           *sensor.GetLatestFrameset());
+  ASSERT_NE(next, nullptr);
+  EXPECT_EQ(next->at<uint16_t>(1, 2), 1003);
+  sensor.Stop();
+}
+
+GTEST_TEST(RGBDSensorTest, DepthRegistrationStage) {
+  SyntheticSensor sensor;
+  sensor.Start({ImageType::RGB, ImageType::DEPTH});
+  DepthRegistrationStage stage(&sensor, {ImageType::RECT_RGB_ALIGNED_DEPTH,
+                                         ImageType::DEPTH_ALIGNED_RGB});
+
+  sensor.Push(ImageType::DEPTH, 1);
+  EXPECT_EQ(stage.GetResult(*sensor.GetLatestFrameset()), nullptr);
+
+  for (uint64_t timestamp = 2; timestamp < 5; timestamp++) {
+    sensor.Push({ImageType::RGB, ImageType::DEPTH}, timestamp);
+    const auto frameset = sensor.GetLatestFrameset();
+    const auto result = stage.GetResult(*frameset);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->depth_timestamp, timestamp);
+    ASSERT_NE(result->aligned_color, nullptr);
+    ASSERT_NE(result->color_uv_map, nullptr);
+    const auto& registered = result->aligned_depth;
+    ASSERT_NE(registered, nullptr);
+    const RawImageData expected = DoRegisterDepthToColor(
+        sensor.get_intrinsics(ImageType::RGB),
+        *sensor.get_ray_table(ImageType::DEPTH),
+        sensor.get_extrinsics(ImageType::DEPTH, ImageType::RGB),
+        *frameset->images[static_cast<int>(ImageType::RGB)],
+        *frameset->images[static_cast<int>(ImageType::DEPTH)],
+        ImageType::DEPTH);
+    ASSERT_EQ(registered->size(), expected.size());
+    EXPECT_EQ(memcmp(registered->data(), expected.data(), expected.size()), 0);
+    EXPECT_EQ(registered->at<uint16_t>(1, 2), 1000 + timestamp);
+  }
+  sensor.Stop();
+}
+
+}  // namespace rs2_lcm
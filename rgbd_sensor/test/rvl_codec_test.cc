@@ -0,0 +1,80 @@
+#include "rgbd_sensor/rvl_codec.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace rs2_lcm {
+namespace {
+
+void ExpectRoundTrip(const std::vector<uint16_t>& depth) {
+  std::vector<uint8_t> encoded;
+  RvlEncode(depth.data(), depth.size(), &encoded);
+  EXPECT_LE(encoded.size(), RvlMaxEncodedSize(depth.size()));
+  EXPECT_EQ(encoded.size() % sizeof(uint32_t), 0);
+
+  std::vector<uint16_t> decoded(depth.size(), 1);
+  RvlDecode(encoded.data(), encoded.size(), decoded.size(), decoded.data());
+  EXPECT_EQ(decoded, depth);
+}
+
+}  // namespace
+
+GTEST_TEST(RvlCodecTest, RoundTrip) {
+  ExpectRoundTrip({});
+  ExpectRoundTrip({0});
+  ExpectRoundTrip({65535});
+  ExpectRoundTrip({0, 0, 0, 65535, 1, 0, 0, 65535, 0});
+  ExpectRoundTrip(std::vector<uint16_t>(1000, 0));
+  ExpectRoundTrip(std::vector<uint16_t>(1000, 1234));
+
+  // Alternating zeros and extreme differences, the worst case for size.
+  std::vector<uint16_t> worst(1001);
+  for (size_t i = 0; i < worst.size(); i++) {
+    worst[i] = i % 2 ? 0 : (i % 4 ? 65535 : 1);
+  }
+  ExpectRoundTrip(worst);
+  for (auto& pixel : worst) pixel = pixel ? pixel : 65535;
+  ExpectRoundTrip(worst);
+
+  // Smooth depth with holes, at a length that is not a multiple of the SIMD
+  // width.
+  std::mt19937 random(1234);
+  std::vector<uint16_t> depth(640 * 480 + 5);
+  int value = 1000;
+  for (auto& pixel : depth) {
+    value += static_cast<int>(random() % 21) - 10;
+    value = std::max(300, std::min(6000, value));
+    pixel = random() % 10 == 0 ? 0 : value;
+  }
+  ExpectRoundTrip(depth);
+}
+
+GTEST_TEST(RvlCodecTest, Compresses) {
+  std::vector<uint16_t> depth(640 * 480);
+  for (size_t i = 0; i < depth.size(); i++) {
+    depth[i] = (i / 640) % 50 < 5 ? 0 : 1000 + (i % 640) / 4;
+  }
+  std::vector<uint8_t> encoded;
+  RvlEncode(depth.data(), depth.size(), &encoded);
+  EXPECT_LT(encoded.size(), depth.size() * sizeof(uint16_t) / 4);
+}
+
+GTEST_TEST(RvlCodecTest, InvalidData) {
+  const std::vector<uint16_t> depth{0, 0, 500, 501, 502, 0, 9000};
+  std::vector<uint8_t> encoded;
+  RvlEncode(depth.data(), depth.size(), &encoded);
+
+  std::vector<uint16_t> decoded(depth.size());
+  EXPECT_THROW(RvlDecode(encoded.data(), encoded.size() - 4, decoded.size(),
+                         decoded.data()),
+               std::runtime_error);
+  // Runs longer than the image.
+  EXPECT_THROW(
+      RvlDecode(encoded.data(), encoded.size(), 1, decoded.data()),
+      std::runtime_error);
+}
+
+}  // namespace rs2_lcm
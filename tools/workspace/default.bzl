@@ -12,9 +12,11 @@ load("//tools/workspace:mirrors.bzl", "DEFAULT_MIRRORS")
 load("//tools/workspace/boost:repository.bzl", "boost_repository")
 load("//tools/workspace/libjpeg:repository.bzl", "libjpeg_repository")
 load("//tools/workspace/libtiff:repository.bzl", "libtiff_repository")
+load("//tools/workspace/lz4:repository.bzl", "lz4_repository")
 load("//tools/workspace/opencv:repository.bzl", "opencv_repository")
 load("//tools/workspace/realsense2:repository.bzl", "realsense2_repository")
 load("//tools/workspace/tbb:repository.bzl", "tbb_repository")
+load("//tools/workspace/zstd:repository.bzl", "zstd_repository")
 
 def add_default_repositories(excludes = [], mirrors = DEFAULT_MIRRORS):
     # N.B. We do *not* pass `mirrors = ` into the drake_add_default_... call.
@@ -31,9 +33,13 @@ def add_default_repositories(excludes = [], mirrors = DEFAULT_MIRRORS):
         libjpeg_repository(name = "libjpeg")
     if "libtiff" not in excludes:
         libtiff_repository(name = "libtiff")
+    if "lz4" not in excludes:
+        lz4_repository(name = "lz4")
     if "opencv" not in excludes:
         opencv_repository(name = "opencv", mirrors = mirrors)
     if "realsense2" not in excludes:
         realsense2_repository(name = "realsense2")
     if "tbb" not in excludes:
         tbb_repository(name = "tbb")
+    if "zstd" not in excludes:
+        zstd_repository(name = "zstd")
@@ -0,0 +1,19 @@
+# -*- mode: python -*-
+# vi: set ft=python :
+
+load(
+    "@drake//tools/workspace:pkg_config.bzl",
+    "pkg_config_repository",
+)
+
+def lz4_repository(
+        name,
+        licenses = ["notice"],  # BSD-2-Clause
+        modname = "liblz4",
+        **kwargs):
+    pkg_config_repository(
+        name = name,
+        licenses = licenses,
+        modname = modname,
+        **kwargs
+    )
@@ -0,0 +1,19 @@
+# -*- mode: python -*-
+# vi: set ft=python :
+
+load(
+    "@drake//tools/workspace:pkg_config.bzl",
+    "pkg_config_repository",
+)
+
+def zstd_repository(
+        name,
+        licenses = ["notice"],  # BSD-3-Clause
+        modname = "libzstd",
+        **kwargs):
+    pkg_config_repository(
+        name = name,
+        licenses = licenses,
+        modname = modname,
+        **kwargs
+    )